@@ -1,11 +1,16 @@
 #include <cstdint>
+#include <cstdlib>
+#include <iostream>
 #include <stdexcept>
 
+#include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
 #include "application.hpp"
 
+#include "benchmarkview.hpp"
 #include "gameview.hpp"
+#include "glcheck.hpp"
 
 namespace
 {
@@ -17,14 +22,29 @@ const unsigned SCREEN_WIDTH = 800;
 const unsigned SCREEN_HEIGHT = 600;
 }
 
-Application::Application()
+Application::Application(bool headless)
 	: mEventQueue()
 	, mWindow()
 	, mTarget()
+	, mRenderThread()
+	, mBackbuffer()
 	, mFonts()
 	, mTextures()
 	, mViewStack({ &mWindow, &mTarget, &mFonts, &mTextures, })
+	, mIsHeadless(headless)
+	, mIsProfiling(false)
+	, mFramesInFlight(2)
 {
+#ifdef GLFW_PLATFORM_NULL
+	// without a display server use the null platform
+	if (headless
+	    && !std::getenv("DISPLAY")
+	    && !std::getenv("WAYLAND_DISPLAY")
+	    && glfwPlatformSupported(GLFW_PLATFORM_NULL))
+	{
+		glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+	}
+#endif
 	if (!glfwInit())
 	{
 		const char *error;
@@ -54,21 +74,51 @@ void
 Application::registerViews()
 {
 	mViewStack.registerView<GameView>(ViewID::GamePlay);
+	mViewStack.registerView<BenchmarkView>(ViewID::Benchmark);
 }
 
 void
-Application::run()
+Application::setProfiling(bool enabled)
+{
+	mIsProfiling = enabled;
+}
+
+void
+Application::setFramesInFlight(unsigned depth)
+{
+	mFramesInFlight = depth;
+}
+
+void
+Application::setup(RenderTarget &target)
 {
-	mWindow.open("SquareChase", SCREEN_WIDTH, SCREEN_HEIGHT);
+	mWindow.open("SquareChase", SCREEN_WIDTH, SCREEN_HEIGHT, !mIsHeadless);
 
 	// track the window events
 	mEventQueue.track(mWindow);
 
-	// tell the target to render on the window
-	mTarget.use(mWindow);
+	// tell the target to render offscreen: the backbuffer keeps
+	// the pixels outside of the damaged regions and it's copied
+	// to the window when visible.
+	if (!mBackbuffer.create(SCREEN_WIDTH, SCREEN_HEIGHT))
+	{
+		throw std::runtime_error("Cannot create the offscreen framebuffer");
+	}
+	target.use(mWindow, &mBackbuffer);
+
+	target.setProfiling(mIsProfiling);
+	target.setFramesInFlight(mFramesInFlight);
 
 	// with a context in use we load the assets
 	loadAssets();
+}
+
+void
+Application::run()
+{
+	// the views record into mTarget, the render thread draws
+	setup(mRenderThread.getTarget());
+	mRenderThread.start(mWindow, mTarget);
 
 	// game loop
 	const std::uint64_t deltaTicks = glfwGetTimerFrequency() / targetFPS;
@@ -91,9 +141,75 @@ Application::run()
 			mViewStack.update(SecondsPerFrame);
 		}
 
-		// render
+		// render only when something changed, otherwise sleep
+		// until the next update or an input event.
+		if (mRenderThread.beginFrame())
+		{
+			mViewStack.render(mTarget);
+			mRenderThread.endFrame();
+		}
+		else if (accumulator < deltaTicks)
+		{
+			glfwWaitEventsTimeout(static_cast<double>(deltaTicks - accumulator)
+					      / glfwGetTimerFrequency());
+		}
+	}
+
+	mRenderThread.stop();
+}
+
+void
+Application::runFrames(unsigned count)
+{
+	setup(mTarget);
+
+	// the sprites are drawn over the frozen game
+	mViewStack.pushView(ViewID::Benchmark);
+
+	// one update per frame, the results don't depend on the
+	// speed of the machine.
+	const std::uint64_t startTicks = glfwGetTimerValue();
+	unsigned frames = 0;
+	for (; frames < count && !mWindow.isClosed() && !mViewStack.empty(); frames++)
+	{
+		processInput();
+		mViewStack.update(SecondsPerFrame);
+
+		// measure the whole frame
+		mTarget.invalidate();
+		mTarget.beginFrame();
 		mViewStack.render(mTarget);
-		mWindow.display();
+		mTarget.endFrame();
+		if (!mIsHeadless)
+		{
+			mTarget.present();
+			mWindow.display();
+		}
+	}
+
+	// wait for the GPU before stopping the clock
+	glCheck(glFinish());
+	const double seconds = static_cast<double>(glfwGetTimerValue() - startTicks)
+		/ glfwGetTimerFrequency();
+	std::cout << frames << " frames in " << seconds << " s, "
+		  << (frames ? seconds * 1000.0 / frames : 0.0) << " ms per frame"
+		  << std::endl;
+
+	if (mIsProfiling)
+	{
+		// NOTE: the last frames are still in flight, the
+		// stats are the ones of a few frames ago.
+		const GpuStats &stats = mTarget.getGpuStats();
+		std::cout << "GPU frame " << stats.frame << ": " << stats.drawTime
+			  << " ms in " << stats.samples << " samples" << std::endl;
+		for (const auto &[label, time] : stats.labels)
+		{
+			std::cout << "  view " << label << ": " << time << " ms" << std::endl;
+		}
+		for (const auto &[slot, time] : stats.textures)
+		{
+			std::cout << "  texture " << slot << ": " << time << " ms" << std::endl;
+		}
 	}
 }
 
@@ -104,6 +220,13 @@ Application::processInput()
 	Event event;
 	while (mEventQueue.pop(event))
 	{
+		// the window content is lost
+		if (std::holds_alternative<WindowRefreshed>(event)
+		    || std::holds_alternative<FramebufferResized>(event))
+		{
+			mTarget.invalidate();
+		}
+
 		if (mViewStack.handleEvent(event))
 		{
 			// event handled by a view in the stack
@@ -3,6 +3,8 @@
 #include "eventqueue.hpp"
 #include "window.hpp"
 #include "rendertarget.hpp"
+#include "renderthread.hpp"
+#include "rendertexture.hpp"
 #include "resources.hpp"
 #include "resourceholder.hpp"
 #include "viewstack.hpp"
@@ -12,12 +14,46 @@
 class Application
 {
 public:
-	Application();
+	/**
+	 * @param[in] headless render into an offscreen framebuffer of
+	 *            a hidden window, the GLFW null platform is used
+	 *            when there's no display.
+	 */
+	explicit Application(bool headless = false);
 	~Application();
 
+	/**
+	 * Measure the GPU time of the views and the textures, the
+	 * stats of the last frame are printed by runFrames().
+	 */
+	void setProfiling(bool enabled);
+
+	/**
+	 * Set how many frames the GPU can lag behind, see
+	 * RenderTarget::setFramesInFlight().
+	 *
+	 * @param[in] depth frames in flight.
+	 */
+	void setFramesInFlight(unsigned depth);
+
+	/**
+	 * Run the game loop until the window is closed. The frames
+	 * are drawn by a RenderThread while the next one is updated.
+	 */
 	void run();
 
+	/**
+	 * Run @count frames with a fixed time step and print the
+	 * average frame time. A BenchmarkView is pushed over the
+	 * game to draw many sprites, the game is frozen and drawn
+	 * from the cache of the ViewStack.
+	 *
+	 * @param[in] count number of frames.
+	 */
+	void runFrames(unsigned count);
+
 private:
+	void setup(RenderTarget &target);
 	void processInput();
 	void loadAssets();
 	void registerViews();
@@ -26,7 +62,12 @@ private:
 	EventQueue    mEventQueue;
 	Window        mWindow;
 	RenderTarget  mTarget;
+	RenderThread  mRenderThread;
+	RenderTexture mBackbuffer;
 	FontHolder    mFonts;
 	TextureHolder mTextures;
 	ViewStack     mViewStack;
+	bool          mIsHeadless;
+	bool          mIsProfiling;
+	unsigned      mFramesInFlight;
 };
@@ -0,0 +1,92 @@
+#include <iterator>
+
+#include "benchmarkview.hpp"
+
+#include "rendertarget.hpp"
+#include "resourceholder.hpp"
+#include "texture.hpp"
+#include "utility.hpp"
+#include "window.hpp"
+
+namespace
+{
+const unsigned SpriteCount = 10000;
+const glm::vec2 SpriteSize(16.f);
+const int MaxSpeed = 200;
+const int MaxSpin = 360;
+
+const Color colors[] = {
+	Color::Red,
+	Color::Green,
+	Color::Blue,
+	Color::Yellow,
+	Color::Magenta,
+	Color::Cyan,
+};
+}
+
+BenchmarkView::BenchmarkView(ViewStack &stack, const Context &context)
+	: mViewStack(stack)
+	, mContext(context)
+{
+	const glm::ivec2 size = mContext.window->getSize();
+	mBodies.reserve(SpriteCount);
+	for (unsigned i = 0; i < SpriteCount; i++)
+	{
+		mBodies.push_back({
+			glm::vec2(Utility::randomInt(size.x), Utility::randomInt(size.y)),
+			glm::vec2(Utility::randomInt(MaxSpeed * 2) - MaxSpeed,
+				  Utility::randomInt(MaxSpeed * 2) - MaxSpeed),
+			static_cast<float>(Utility::randomInt(360)),
+			static_cast<float>(Utility::randomInt(MaxSpin * 2) - MaxSpin),
+			colors[i % std::size(colors)],
+		});
+	}
+	mSprites.reserve(SpriteCount);
+}
+
+bool
+BenchmarkView::update(float dt)
+{
+	// the sprites bounce on the borders of the window
+	const glm::vec2 size = mContext.window->getSize();
+	for (auto &body : mBodies)
+	{
+		body.position += body.velocity * dt;
+		body.rotation += body.spin * dt;
+		for (int axis = 0; axis < 2; axis++)
+		{
+			if ((body.position[axis] < 0.f && body.velocity[axis] < 0.f)
+			    || (body.position[axis] > size[axis] && body.velocity[axis] > 0.f))
+			{
+				body.velocity[axis] = -body.velocity[axis];
+			}
+		}
+	}
+
+	// the sprites cover the whole window, the game below is frozen
+	// and drawn from the cache of the view stack.
+	mContext.target->invalidate();
+	return true;
+}
+
+bool
+BenchmarkView::handleEvent(const Event &event)
+{
+	(void)event;
+	return false;
+}
+
+void
+BenchmarkView::render(RenderTarget &target)
+{
+	const FloatRect uvRect(glm::vec2(0.f), glm::vec2(1.f));
+	mSprites.clear();
+	for (const auto &body : mBodies)
+	{
+		mSprites.add(body.position, SpriteSize, SpriteSize * 0.5f,
+			     body.rotation, uvRect, body.color);
+	}
+	mSprites.draw(target, &mContext.textures->get(TextureID::Square));
+	target.draw();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "color.hpp"
+#include "spritebatch.hpp"
+#include "view.hpp"
+#include "viewstack.hpp"
+
+/**
+ * A view bouncing many spinning sprites over the views below, drawn
+ * through a SpriteBatch. It's pushed by Application::runFrames() to
+ * measure the sprite path, the views below are not updated and are
+ * rendered from the cache of the ViewStack.
+ */
+class BenchmarkView: public View
+{
+public:
+	BenchmarkView(ViewStack &stack, const Context &context);
+	virtual ~BenchmarkView() override = default;
+
+	virtual bool update(float dt) override;
+	virtual bool handleEvent(const Event &event) override;
+	virtual void render(RenderTarget &target) override;
+
+private:
+	struct Body
+	{
+		glm::vec2 position;
+		glm::vec2 velocity;
+		float rotation;
+		float spin;
+		Color color;
+	};
+
+private:
+	ViewStack &mViewStack;
+	const Context &mContext;
+	std::vector<Body> mBodies;
+	SpriteBatch mSprites;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+enum class BlendMode
+{
+	Alpha,
+	Add,
+	Multiply,
+	None,
+};
@@ -128,3 +128,15 @@ Camera::getInverse() const
 	}
 	return mInverse;
 }
+
+FloatRect
+Camera::getBounds() const
+{
+	const float angle = glm::radians(mRotation);
+	const float cos = std::abs(std::cos(angle));
+	const float sin = std::abs(std::sin(angle));
+	const glm::vec2 half(
+		(mSize.x * cos + mSize.y * sin) * 0.5f,
+		(mSize.x * sin + mSize.y * cos) * 0.5f);
+	return FloatRect(mCenter - half, half * 2.f);
+}
@@ -28,6 +28,12 @@ public:
 	const glm::mat4& getTransform() const;
 	const glm::mat4& getInverse() const;
 
+	/**
+	 * Get a conservative world space box of the visible area,
+	 * the rotation of the camera is taken into account.
+	 */
+	FloatRect getBounds() const;
+
 private:
 	glm::vec2 mCenter;
 	glm::vec2 mSize;
@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cassert>
+
+#include "drawlist.hpp"
+
+namespace
+{
+// grow geometrically, an exact reserve would reallocate on each
+// primitive.
+template <typename T>
+void
+reserveMore(std::vector<T> &vector, std::size_t count)
+{
+	if (vector.size() + count > vector.capacity())
+	{
+		vector.reserve(std::max(vector.capacity() * 2, vector.size() + count));
+	}
+}
+}
+
+DrawList::DrawList()
+	: mTexture(nullptr)
+	, mBlendMode(BlendMode::Alpha)
+	, mNewLayer(false)
+{
+}
+
+void
+DrawList::clear()
+{
+	mCommands.clear();
+	mVertices.clear();
+	mIndices.clear();
+	mQuads.clear();
+	mTexture = nullptr;
+	mBlendMode = BlendMode::Alpha;
+	mNewLayer = false;
+}
+
+bool
+DrawList::empty() const
+{
+	return mCommands.empty();
+}
+
+void
+DrawList::setTexture(const Texture *texture)
+{
+	mTexture = texture;
+}
+
+void
+DrawList::setBlendMode(BlendMode mode)
+{
+	mBlendMode = mode;
+}
+
+void
+DrawList::addLayer()
+{
+	mNewLayer = true;
+}
+
+DrawList::Command &
+DrawList::getCommand(Primitive primitive)
+{
+	// start a new command when the state changes
+	if (mCommands.empty()
+	    || mNewLayer
+	    || mCommands.back().texture != mTexture
+	    || mCommands.back().blend != mBlendMode
+	    || mCommands.back().primitive != primitive)
+	{
+		mCommands.push_back({
+			mTexture,
+			mBlendMode,
+			primitive,
+			mNewLayer,
+			static_cast<unsigned>(mVertices.size()), 0,
+			static_cast<unsigned>(mIndices.size()), 0,
+			static_cast<unsigned>(mQuads.size()), 0,
+		});
+		mNewLayer = false;
+	}
+	return mCommands.back();
+}
+
+unsigned
+DrawList::getPrimIndex(unsigned idxCount, unsigned vtxCount)
+{
+	auto &command = getCommand(Primitive::Triangles);
+	reserveMore(mVertices, vtxCount);
+	reserveMore(mIndices, idxCount);
+
+	// indices are relative to the first vertex of the command
+	return mVertices.size() - command.vtxOffset;
+}
+
+Vertex*
+DrawList::getVertexArray(unsigned vtxCount)
+{
+	assert(!mCommands.empty() && "getPrimIndex() not called");
+	auto &command = mCommands.back();
+	auto size = mVertices.size();
+	mVertices.resize(size + vtxCount);
+	command.vtxCount += vtxCount;
+	return &mVertices[size];
+}
+
+Vertex*
+DrawList::getQuadVertexArray(unsigned count)
+{
+	auto &command = getCommand(Primitive::QuadList);
+	auto size = mVertices.size();
+	mVertices.resize(size + count * 4);
+	command.vtxCount += count * 4;
+	return &mVertices[size];
+}
+
+Quad*
+DrawList::getQuadArray(unsigned count)
+{
+	auto &command = getCommand(Primitive::Quads);
+	auto size = mQuads.size();
+	mQuads.resize(size + count);
+	command.quadCount += count;
+	return &mQuads[size];
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "blendmode.hpp"
+#include "vertex.hpp"
+
+class RenderTarget;
+class Texture;
+
+/**
+ * A recording context for the primitives of a RenderTarget.
+ *
+ * A DrawList owns its vertices, indices and quads and doesn't touch
+ * any OpenGL state, so each worker thread can fill its own list in
+ * parallel. The lists are then merged into the current batch on the
+ * rendering thread with RenderTarget::submit().
+ */
+class DrawList
+{
+public:
+	DrawList();
+
+	/**
+	 * Remove all the recorded primitives, the memory is kept.
+	 */
+	void clear();
+
+	/**
+	 * Check if no primitive has been recorded.
+	 */
+	bool empty() const;
+
+	/**
+	 * Set the texture for the next primitive.
+	 */
+	void setTexture(const Texture *texture);
+
+	/**
+	 * Set the blending mode for the next primitive.
+	 */
+	void setBlendMode(BlendMode mode);
+
+	/**
+	 * Start a new layer, see RenderTarget::addLayer().
+	 */
+	void addLayer();
+
+	/**
+	 * Get the base index for the primitive and reserve space in
+	 * the vertex and index buffers.
+	 */
+	unsigned getPrimIndex(unsigned idxCount, unsigned vtxCount);
+
+	/**
+	 * Add a sequence of indices with an @offset applied to them.
+	 * The offset is obtained by using getPrimIndex().
+	 *
+	 * @param[in] offset offset to add to each index.
+	 * @param[in] start first iterator of the range.
+	 * @param[in] end end iterator of the range.
+	 */
+	template <typename Iterator>
+	void addIndices(unsigned offset, Iterator start, Iterator end);
+
+	Vertex* getVertexArray(unsigned vtxCount);
+
+	/**
+	 * See RenderTarget::getQuadVertexArray().
+	 */
+	Vertex* getQuadVertexArray(unsigned count);
+
+	/**
+	 * See RenderTarget::getQuadArray().
+	 */
+	Quad* getQuadArray(unsigned count);
+
+private:
+	friend class FramePacket;
+	friend class RenderTarget;
+	friend class RetainedBatch;
+
+	enum class Primitive
+	{
+		Triangles,
+		QuadList,
+		Quads,
+	};
+
+	struct Command
+	{
+		const Texture *texture;
+		BlendMode blend;
+		Primitive primitive;
+		bool newLayer;
+		unsigned vtxOffset;
+		unsigned vtxCount;
+		unsigned idxOffset;
+		unsigned idxCount;
+		unsigned quadOffset;
+		unsigned quadCount;
+	};
+
+private:
+	Command &getCommand(Primitive primitive);
+
+private:
+	std::vector<Command>       mCommands;
+	std::vector<Vertex>        mVertices;
+	std::vector<std::uint32_t> mIndices;
+	std::vector<Quad>          mQuads;
+	const Texture             *mTexture;
+	BlendMode                  mBlendMode;
+	bool                       mNewLayer;
+};
+
+template <typename Iterator>
+void
+DrawList::addIndices(unsigned offset, Iterator start, Iterator end)
+{
+	for (; start != end; ++start)
+	{
+		mIndices.push_back(offset + *start);
+	}
+	mCommands.back().idxCount = mIndices.size() - mCommands.back().idxOffset;
+}
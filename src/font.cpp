@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <stdexcept>
 #include <string>
@@ -12,6 +13,15 @@ const int TEXTURE_WIDTH = 1024;
 const int TEXTURE_HEIGHT = 1024;
 const int PADDING = 2;
 
+// the smallest rectangle containing both
+IntRect
+merge(const IntRect &a, const IntRect &b)
+{
+	const glm::ivec2 low = glm::min(a.pos, b.pos);
+	const glm::ivec2 high = glm::max(a.pos + a.size, b.pos + b.size);
+	return IntRect(low, high - low);
+}
+
 static inline unsigned
 roundUp2(unsigned v)
 {
@@ -26,7 +36,9 @@ roundUp2(unsigned v)
 }
 
 Font::Font()
-	: mFT(nullptr)
+	: mTextureSize(0)
+	, mIsDirty(false)
+	, mFT(nullptr)
 	, mFace(nullptr)
 	, mLineHeight(0)
 	, mPositionX(0)
@@ -64,6 +76,9 @@ Font::loadFromFile(const std::filesystem::path &path, unsigned size)
 	mLineHeight = static_cast<int>((mFace->size->metrics.ascender -
 					mFace->size->metrics.descender) >> 6);
 	mGlyphs.clear();
+	mPixels.clear();
+	mTextureSize = glm::ivec2(0);
+	mIsDirty = false;
 	mPositionX = mPositionY = mMaxHeight = 0;
 
 	return true;
@@ -77,36 +92,47 @@ Font::draw(RenderTarget &target, glm::vec2 pos, const std::string &text, Color c
 		return;
 	}
 
+	// skip the text out of the camera bounds, the glyphs are
+	// loaded anyway to measure it.
 	auto codepoints = Utility::decodeUTF8(text);
+	glm::vec2 low(pos.x, pos.y + mLineHeight);
+	glm::vec2 high = low;
+	float x = pos.x;
 	for (auto codepoint : codepoints)
 	{
-		getGlyph(codepoint);
+		const auto &glyph = getGlyph(codepoint);
+		const glm::vec2 corner(x + glyph.bearing.x,
+				       pos.y + mLineHeight - glyph.bearing.y);
+		low = glm::min(low, corner);
+		high = glm::max(high, corner + glyph.size);
+		x += glyph.advance;
+	}
+	if (!target.isVisible(FloatRect(low, high - low)))
+	{
+		return;
+	}
+
+	// upload the glyphs added since the last draw
+	if (mIsDirty)
+	{
+		target.updateTexture(mTexture, mPixels.data(), mTextureSize, mDirty);
+		mIsDirty = false;
 	}
 
-	static const std::uint16_t indices[] = { 0, 1, 2, 1, 3, 2 };
-	static const glm::vec2 unit[] = {
-		{ 0.f, 0.f },
-		{ 0.f, 1.f },
-		{ 1.f, 0.f },
-		{ 1.f, 1.f },
-	};
 	target.setTexture(&mTexture);
+	Quad *quad = target.getQuadArray(codepoints.size());
 	pos.y += mLineHeight;
 	for (auto codepoint : codepoints)
 	{
-		unsigned base = target.getPrimIndex(6, 4);
-		target.addIndices(base, indices + 0, indices + 6);
-		Vertex *vertices = target.getVertexArray(4);
-
 		const auto &glyph = getGlyph(codepoint);
 		pos.x += glyph.bearing.x;
 		pos.y -= glyph.bearing.y;
-		for (int i = 0; i < 4; i++)
-		{
-			vertices[i].pos = glyph.size * unit[i] + pos;
-			vertices[i].uv = glyph.uvSize * unit[i] + glyph.uvPos;
-			vertices[i].color = color;
-		}
+		quad->pos = pos;
+		quad->size = glyph.size;
+		quad->uvPos = glyph.uvPos;
+		quad->uvSize = glyph.uvSize;
+		quad->color = color;
+		quad++;
 		pos.x += glyph.advance - glyph.bearing.x;
 		pos.y += glyph.bearing.y;
 	}
@@ -140,13 +166,25 @@ Font::getTexture() const
 void
 Font::resizeTexture(unsigned newWidth, unsigned newHeight) const
 {
-	auto oldWidth = mTexture.getWidth();
-	auto oldHeight = mTexture.getHeight();
+	const unsigned oldWidth = mTextureSize.x;
+	const unsigned oldHeight = mTextureSize.y;
 
-	Texture newTexture;
-	newTexture.create(newWidth, newHeight);
-	newTexture.update(mTexture);
-	std::swap(mTexture, newTexture);
+	// the empty space is transparent white
+	std::vector<std::uint8_t> pixels(newWidth * newHeight * 4, 255);
+	for (std::size_t i = 3; i < pixels.size(); i += 4)
+	{
+		pixels[i] = 0;
+	}
+	for (unsigned y = 0; y < oldHeight; y++)
+	{
+		std::copy_n(&mPixels[y * oldWidth * 4], oldWidth * 4, &pixels[y * newWidth * 4]);
+	}
+	std::swap(mPixels, pixels);
+	mTextureSize = glm::ivec2(newWidth, newHeight);
+
+	// the texture is created again with the new size
+	mDirty = IntRect(glm::ivec2(0), mTextureSize);
+	mIsDirty = true;
 
 	glm::vec2 scale{
 		static_cast<float>(oldWidth) / newWidth,
@@ -181,8 +219,8 @@ Font::getGlyph(char32_t codepoint) const
 		mMaxHeight = bmHeight;
 	}
 
-	auto texWidth = mTexture.getWidth();
-	auto texHeight = mTexture.getHeight();
+	unsigned texWidth = mTextureSize.x;
+	unsigned texHeight = mTextureSize.y;
 	bool resize = false;
 	if (unsigned right = mPositionX + bmWidth; right > texWidth)
 	{
@@ -222,31 +260,24 @@ Font::getGlyph(char32_t codepoint) const
 		resizeTexture(texWidth, texHeight);
 	}
 
-	// clear the pixel buffer
-	mPixelBuffer.resize(bmWidth * bmHeight * 4);
-	std::uint8_t *pix = mPixelBuffer.data();
-	for (std::size_t i = 0; i < mPixelBuffer.size() / 4; ++i)
-	{
-		*pix++ = 255;
-		*pix++ = 255;
-		*pix++ = 255;
-		*pix++ = 0;
-	}
-
-	// render the pixel
-	pix = mFace->glyph->bitmap.buffer;
+	// render the pixels, the padding is left transparent
+	const std::uint8_t *pix = mFace->glyph->bitmap.buffer;
 	for (int y = PADDING; y < bmHeight - PADDING; ++y)
 	{
 		for (int x = PADDING; x < bmWidth - PADDING; ++x)
 		{
-			const std::size_t index = x + y * bmWidth;
-			mPixelBuffer[index * 4 + 3] = pix[x - PADDING];
+			const std::size_t index = (mPositionX + x)
+				+ (mPositionY + y) * texWidth;
+			mPixels[index * 4 + 3] = pix[x - PADDING];
 		}
 		pix += mFace->glyph->bitmap.pitch;
 	}
 
-	// upload the data
-	mTexture.update(mPixelBuffer.data(), mPositionX, mPositionY, bmWidth, bmHeight);
+	// the region is uploaded by the next draw
+	const IntRect area(glm::ivec2(mPositionX, mPositionY),
+			   glm::ivec2(bmWidth, bmHeight));
+	mDirty = mIsDirty ? merge(mDirty, area) : area;
+	mIsDirty = true;
 
 	bmWidth -= 2 * PADDING;
 	bmHeight -= 2 * PADDING;
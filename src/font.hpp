@@ -10,10 +10,19 @@
 #include FT_FREETYPE_H
 
 #include "color.hpp"
+#include "rect.hpp"
 #include "texture.hpp"
 
 class RenderTarget;
 
+/**
+ * A font rasterized on demand into a texture atlas.
+ *
+ * The glyphs are rendered into a copy of the atlas kept in memory,
+ * draw() hands the changed region to RenderTarget::updateTexture():
+ * no OpenGL call is made by the font itself, so the text can be
+ * drawn while recording for a RenderThread.
+ */
 class Font
 {
 public:
@@ -44,7 +53,10 @@ private:
 
 private:
 	mutable std::unordered_map<char32_t, Glyph> mGlyphs;
-	mutable std::vector<std::uint8_t> mPixelBuffer;
+	mutable std::vector<std::uint8_t> mPixels;
+	mutable glm::ivec2 mTextureSize;
+	mutable IntRect mDirty;
+	mutable bool mIsDirty;
 	mutable Texture mTexture;
 	FT_Library mFT;
 	mutable FT_Face mFace;
@@ -0,0 +1,108 @@
+#include <utility>
+
+#include "framepacket.hpp"
+
+FramePacket::FramePacket()
+	: mListCount(0)
+	, mIsListOpen(false)
+	, mTexture(nullptr)
+	, mBlendMode(BlendMode::Alpha)
+	, mIsDamaged(false)
+	, mIsFullyDamaged(false)
+	, mIsPresented(false)
+{
+}
+
+void
+FramePacket::clear()
+{
+	mCommands.clear();
+	mListCount = 0;
+	mIsListOpen = false;
+	mTexture = nullptr;
+	mBlendMode = BlendMode::Alpha;
+	mIsDamaged = false;
+	mIsFullyDamaged = false;
+	mIsPresented = false;
+}
+
+DrawList&
+FramePacket::getList()
+{
+	if (!mIsListOpen)
+	{
+		// the lists are reused from the previous frames
+		if (mListCount == mLists.size())
+		{
+			mLists.emplace_back();
+		}
+		DrawList &list = mLists[mListCount];
+		list.clear();
+		list.setTexture(mTexture);
+		list.setBlendMode(mBlendMode);
+		mIsListOpen = true;
+	}
+	return mLists[mListCount];
+}
+
+void
+FramePacket::closeList()
+{
+	// NOTE: an empty list stays open, it keeps the pending layer.
+	if (mIsListOpen && !mLists[mListCount].empty())
+	{
+		mCommands.push_back(Submit{ mListCount });
+		mListCount++;
+		mIsListOpen = false;
+	}
+}
+
+void
+FramePacket::push(Command command)
+{
+	// keep the order of the primitives and of the state changes
+	closeList();
+	mCommands.push_back(std::move(command));
+}
+
+void
+FramePacket::submit(const DrawList &list)
+{
+	// an empty list adds nothing, the open one keeps its pending layer
+	if (list.empty())
+	{
+		return;
+	}
+
+	// NOTE: an open list is empty once closed, its pending layer
+	// starts the submitted one.
+	closeList();
+	const bool newLayer = mIsListOpen && mLists[mListCount].mNewLayer;
+	DrawList &copy = getList();
+	copy = list;
+	if (newLayer)
+	{
+		copy.mCommands.front().newLayer = true;
+	}
+	closeList();
+}
+
+void
+FramePacket::setTexture(const Texture *texture)
+{
+	mTexture = texture;
+	if (mIsListOpen)
+	{
+		mLists[mListCount].setTexture(texture);
+	}
+}
+
+void
+FramePacket::setBlendMode(BlendMode mode)
+{
+	mBlendMode = mode;
+	if (mIsListOpen)
+	{
+		mLists[mListCount].setBlendMode(mode);
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <variant>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "blendmode.hpp"
+#include "camera.hpp"
+#include "color.hpp"
+#include "drawlist.hpp"
+#include "particlesystem.hpp"
+#include "rect.hpp"
+#include "vertex.hpp"
+
+class RenderTexture;
+class RetainedBatch;
+class Texture;
+
+/**
+ * The draws of a frame recorded by a RenderTarget, see
+ * RenderTarget::record().
+ *
+ * The primitives are kept in DrawLists and the calls changing the
+ * OpenGL state in a list of commands, so a packet can be filled by
+ * the main thread while a RenderThread replays the previous one.
+ * Once handed to the RenderThread a packet is not changed anymore.
+ */
+class FramePacket
+{
+public:
+	FramePacket();
+
+	/**
+	 * Remove the recorded frame, the memory is kept.
+	 */
+	void clear();
+
+private:
+	friend class RenderTarget;
+
+	struct Clear
+	{
+		Color color;
+	};
+
+	struct Submit
+	{
+		unsigned list;
+	};
+
+	struct Draw
+	{
+	};
+
+	struct DrawRetained
+	{
+		RetainedBatch *batch;
+		glm::mat4 transform;
+	};
+
+	struct DrawParticles
+	{
+		ParticleSystem *particles;
+		ParticleSystem::Step step;
+	};
+
+	struct SetCamera
+	{
+		Camera camera;
+	};
+
+	struct SetRenderTexture
+	{
+		RenderTexture *texture;
+		glm::ivec2 size;
+	};
+
+	struct SetProfileLabel
+	{
+		const char *label;
+	};
+
+	struct SetVertexFormat
+	{
+		VertexFormat format;
+	};
+
+	struct SetTextureUnits
+	{
+		unsigned count;
+	};
+
+	struct SetDepthSorting
+	{
+		bool enabled;
+	};
+
+	struct SetQuadExpansion
+	{
+		QuadExpansion expansion;
+	};
+
+	struct UpdateTexture
+	{
+		Texture *texture;
+		glm::ivec2 size;
+		IntRect area;
+		std::vector<std::uint8_t> pixels;
+	};
+
+	using Command = std::variant<
+		Clear,
+		Submit,
+		Draw,
+		DrawRetained,
+		DrawParticles,
+		SetCamera,
+		SetRenderTexture,
+		SetProfileLabel,
+		SetVertexFormat,
+		SetTextureUnits,
+		SetDepthSorting,
+		SetQuadExpansion,
+		UpdateTexture>;
+
+private:
+	DrawList& getList();
+	void closeList();
+	void push(Command command);
+	void submit(const DrawList &list);
+	void setTexture(const Texture *texture);
+	void setBlendMode(BlendMode mode);
+
+private:
+	std::vector<Command>  mCommands;
+	std::vector<DrawList> mLists;
+	unsigned              mListCount;
+	bool                  mIsListOpen;
+	const Texture        *mTexture;
+	BlendMode             mBlendMode;
+
+	FloatRect mDamage;
+	bool      mIsDamaged;
+	bool      mIsFullyDamaged;
+	bool      mIsPresented;
+};
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <GL/glew.h>
+
+#include "framesync.hpp"
+#include "glcheck.hpp"
+
+namespace
+{
+// wait in slices of 100ms to stay responsive to lost contexts
+const GLuint64 WaitTimeout = 100000000;
+}
+
+FrameSync::FrameSync()
+	: mFences{}
+	, mDepth(2)
+	, mFrame(0)
+	, mCompleted(0)
+{
+}
+
+FrameSync::~FrameSync()
+{
+	for (auto fence : mFences)
+	{
+		release(fence);
+	}
+}
+
+void
+FrameSync::setDepth(unsigned depth)
+{
+	mDepth = std::clamp(depth, 1u, MaxDepth);
+}
+
+void
+FrameSync::endFrame()
+{
+	// make room for the fence of this frame first: with fewer than
+	// mDepth frames in flight, the slot of the frame doesn't hold
+	// a fence not waited yet.
+	while (mFrame - mCompleted >= mDepth)
+	{
+		auto &oldest = mFences[mCompleted % MaxDepth];
+		wait(oldest);
+		oldest = nullptr;
+		mCompleted++;
+	}
+
+	mFences[mFrame % MaxDepth] = fence();
+	mFrame++;
+}
+
+void *
+FrameSync::fence()
+{
+	GLsync sync;
+	glCheck(sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+	return sync;
+}
+
+void
+FrameSync::wait(void *fence)
+{
+	if (!fence)
+	{
+		return;
+	}
+
+	// flush the first time, the fence could be still queued
+	GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+	for (;;)
+	{
+		GLenum status;
+		glCheck(status = glClientWaitSync(static_cast<GLsync>(fence), flags, WaitTimeout));
+		if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+		{
+			break;
+		}
+		else if (status == GL_WAIT_FAILED)
+		{
+			release(fence);
+			throw std::runtime_error("FrameSync::wait() - cannot wait for the fence");
+		}
+		flags = 0;
+	}
+	release(fence);
+}
+
+void
+FrameSync::release(void *fence)
+{
+	if (fence)
+	{
+		glCheck(glDeleteSync(static_cast<GLsync>(fence)));
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Limit how many frames the CPU can queue ahead of the GPU.
+ *
+ * The commands of each frame are fenced with glFenceSync() when
+ * the frame ends, the CPU waits for the oldest fence when the frames
+ * in flight exceed the depth.
+ */
+class FrameSync
+{
+public:
+	static const unsigned MaxDepth = 3;
+
+public:
+	FrameSync();
+	~FrameSync();
+
+	FrameSync(const FrameSync &) = delete;
+	FrameSync(FrameSync &&) noexcept = delete;
+	FrameSync& operator=(const FrameSync &) = delete;
+	FrameSync& operator=(FrameSync &&) noexcept = delete;
+
+	/**
+	 * Set the number of frames the GPU can lag behind, between 1
+	 * and MaxDepth.
+	 *
+	 * @param[in] depth frames in flight.
+	 */
+	void setDepth(unsigned depth);
+
+	/**
+	 * Fence the commands of the current frame and wait until the
+	 * frames in flight are no more than the depth.
+	 */
+	void endFrame();
+
+	/**
+	 * Insert a fence after the commands submitted so far.
+	 */
+	static void *fence();
+
+	/**
+	 * Wait for the @fence and delete it, null is ignored.
+	 */
+	static void wait(void *fence);
+
+	/**
+	 * Delete the @fence without waiting, null is ignored.
+	 */
+	static void release(void *fence);
+
+private:
+	void         *mFences[MaxDepth];
+	unsigned      mDepth;
+	std::uint64_t mFrame;
+	std::uint64_t mCompleted;
+};
@@ -21,6 +21,12 @@ const float DeltaTime = 0.25f;
 
 const float MaxTimeWithoutHits = 10.f;
 
+// burst of particles on each hit
+const unsigned MaxParticles = 1 << 16;
+const unsigned HitParticles = 2048;
+const float HitSpeed = 150.f;
+const float HitLifetime = 1.f;
+
 const Color colors[] = {
 	Color::Red,
 	Color::Green,
@@ -37,12 +43,15 @@ GameView::GameView(ViewStack &stack, const Context &context)
 	, mTimePerSquare(MaxTimePerSquare)
 	, mTimeWithoutHits(0.f)
 	, mRectangle{{0.f, 0.f}, {MaxSize, MaxSize}}
+	, mParticles(MaxParticles)
 {
 }
 
 bool
 GameView::update(float dt)
 {
+	const FloatRect rectangle = mRectangle;
+	const int score = mPlayerScore;
 	if (mTimeRemaining <= 0.f)
 	{
 		mRectangle.pos.x = Utility::randomInt(mContext.window->getSize().x - 25);
@@ -55,6 +64,8 @@ GameView::update(float dt)
 	mContext.window->getMouseState(mx, my, mb);
 	if ((mb & 1) != 0 && mRectangle.contains({mx, my}))
 	{
+		mParticles.emit(mRectangle.pos + mRectangle.size * 0.5f, HitParticles,
+				colors[ mPlayerScore % 3 ], HitSpeed, HitLifetime);
 		mPlayerScore++;
 		mTimeRemaining = 0.f;
 		mTimeWithoutHits = 0.f;
@@ -86,6 +97,20 @@ GameView::update(float dt)
 	}
 	mContext.window->setTitle("Score: " + std::to_string(mPlayerScore));
 
+	// the color of the square depends on the score
+	if (mRectangle != rectangle || mPlayerScore != score)
+	{
+		mContext.target->invalidate(rectangle);
+		mContext.target->invalidate(mRectangle);
+	}
+
+	// the particles move on their own until they die
+	mParticles.update(dt);
+	if (mParticles.isActive())
+	{
+		mContext.target->invalidate(mParticles.getBounds());
+	}
+
 	return true;
 }
 
@@ -101,22 +126,16 @@ GameView::render(RenderTarget &target)
 {
 	const Color color(0x99, 0xBB, 0xFF);
 	target.clear(color);
-	static const std::uint16_t indices[6] = { 0, 1, 2, 1, 3, 2 };
-	static const glm::vec2 units[] = {
-		{ 0.f, 0.f },
-		{ 0.f, 1.f },
-		{ 1.f, 0.f },
-		{ 1.f, 1.f },
-	};
 	target.setTexture(&mContext.textures->get(TextureID::Square));
-	auto base = target.getPrimIndex(6, 4);
-	target.addIndices(base, indices + 0, indices + 6);
-	auto vertices = target.getVertexArray(4);
-	for (int i = 0; i < 4; i++)
+	Quad *quad = target.getQuadArray(1);
+	quad->pos = mRectangle.pos;
+	quad->size = mRectangle.size;
+	quad->uvPos = glm::vec2(0.f);
+	quad->uvSize = glm::vec2(1.f);
+	quad->color = colors[ mPlayerScore % 3 ];
+	target.draw();
+	if (mParticles.isActive() && target.isVisible(mParticles.getBounds()))
 	{
-		vertices[i].pos = units[i] * mRectangle.size + mRectangle.pos;
-		vertices[i].uv = units[i];
-		vertices[i].color = colors[ mPlayerScore % 3 ];
+		target.draw(mParticles);
 	}
-	target.draw();
 }
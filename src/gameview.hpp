@@ -1,5 +1,6 @@
 #pragma once
 
+#include "particlesystem.hpp"
 #include "view.hpp"
 #include "viewstack.hpp"
 #include "rect.hpp"
@@ -22,4 +23,5 @@ private:
 	float mTimePerSquare;
 	float mTimeWithoutHits;
 	FloatRect mRectangle;
+	ParticleSystem mParticles;
 };
@@ -0,0 +1,140 @@
+#include <GL/glew.h>
+
+#include "glcheck.hpp"
+#include "gpuprofiler.hpp"
+
+GpuProfiler::GpuProfiler()
+	: mIsEnabled(false)
+	, mFrame(0)
+	, mLabel(nullptr)
+	, mLastTimestamp(0)
+	, mCurrent{ 0, 0.0, 0, {}, {} }
+	, mStats{ 0, 0.0, 0, {}, {} }
+{
+}
+
+GpuProfiler::~GpuProfiler()
+{
+	for (const auto &record : mPending)
+	{
+		if (record.query)
+		{
+			mFreeQueries.push_back(record.query);
+		}
+	}
+	if (!mFreeQueries.empty())
+	{
+		glCheck(glDeleteQueries(mFreeQueries.size(), mFreeQueries.data()));
+	}
+}
+
+void
+GpuProfiler::setEnabled(bool enabled)
+{
+	mIsEnabled = enabled;
+}
+
+bool
+GpuProfiler::isEnabled() const
+{
+	return mIsEnabled;
+}
+
+void
+GpuProfiler::begin(const char *label)
+{
+	if (mIsEnabled)
+	{
+		mLabel = label ? label : "unlabeled";
+		push(RecordType::Begin, NoTexture);
+	}
+}
+
+void
+GpuProfiler::mark(unsigned texture)
+{
+	if (mIsEnabled)
+	{
+		push(RecordType::Mark, texture);
+	}
+}
+
+void
+GpuProfiler::endFrame()
+{
+	mPending.push_back({ RecordType::FrameEnd, 0, mFrame, nullptr, NoTexture });
+	mFrame++;
+	collect();
+}
+
+const GpuStats&
+GpuProfiler::getStats() const
+{
+	return mStats;
+}
+
+void
+GpuProfiler::push(RecordType type, unsigned texture)
+{
+	unsigned query;
+	if (mFreeQueries.empty())
+	{
+		glCheck(glGenQueries(1, &query));
+	}
+	else
+	{
+		query = mFreeQueries.back();
+		mFreeQueries.pop_back();
+	}
+
+	glCheck(glQueryCounter(query, GL_TIMESTAMP));
+	mPending.push_back({ type, query, mFrame, mLabel, texture });
+}
+
+void
+GpuProfiler::collect()
+{
+	// NOTE: the GPU completes the queries in order, stop at the
+	// first one not available.
+	while (!mPending.empty())
+	{
+		const Record &record = mPending.front();
+		if (record.type == RecordType::FrameEnd)
+		{
+			// keep the allocated buckets of the old stats
+			std::swap(mStats, mCurrent);
+			mStats.frame = record.frame;
+			mCurrent.drawTime = 0.0;
+			mCurrent.samples = 0;
+			mCurrent.labels.clear();
+			mCurrent.textures.clear();
+			mPending.pop_front();
+			continue;
+		}
+
+		GLint available;
+		glCheck(glGetQueryObjectiv(record.query, GL_QUERY_RESULT_AVAILABLE, &available));
+		if (!available)
+		{
+			break;
+		}
+
+		GLuint64 timestamp;
+		glCheck(glGetQueryObjectui64v(record.query, GL_QUERY_RESULT, &timestamp));
+		if (record.type == RecordType::Mark)
+		{
+			const double time = (timestamp - mLastTimestamp) * 1e-6;
+			mCurrent.drawTime += time;
+			mCurrent.samples++;
+			mCurrent.labels[record.label] += time;
+			if (record.texture != NoTexture)
+			{
+				mCurrent.textures[record.texture] += time;
+			}
+		}
+		mLastTimestamp = timestamp;
+
+		mFreeQueries.push_back(record.query);
+		mPending.pop_front();
+	}
+}
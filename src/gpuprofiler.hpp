@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * GPU time of a frame, in milliseconds.
+ */
+struct GpuStats
+{
+	unsigned frame;
+	double   drawTime;
+	unsigned samples;
+
+	// time by label and by texture slot (see Texture::getSlot())
+	std::unordered_map<std::string, double> labels;
+	std::unordered_map<unsigned, double>    textures;
+};
+
+/**
+ * A pool of GL_TIMESTAMP queries measuring groups of draws.
+ *
+ * The results are read back only when available, a few frames
+ * later, so the profiler never waits for the GPU.
+ */
+class GpuProfiler
+{
+public:
+	static const unsigned NoTexture = ~0u;
+
+public:
+	GpuProfiler();
+	~GpuProfiler();
+
+	GpuProfiler(const GpuProfiler &) = delete;
+	GpuProfiler(GpuProfiler &&) noexcept = delete;
+	GpuProfiler& operator=(const GpuProfiler &) = delete;
+	GpuProfiler& operator=(GpuProfiler &&) noexcept = delete;
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+
+	/**
+	 * Start measuring the draws attributed to @label, it must
+	 * point to a string with static storage.
+	 */
+	void begin(const char *label);
+
+	/**
+	 * Attribute the time since the previous begin() or mark() to
+	 * the @texture slot.
+	 */
+	void mark(unsigned texture);
+
+	/**
+	 * Close the current frame and collect the available results.
+	 */
+	void endFrame();
+
+	/**
+	 * Get the stats of the last frame completed by the GPU.
+	 */
+	const GpuStats& getStats() const;
+
+private:
+	enum class RecordType
+	{
+		Begin,
+		Mark,
+		FrameEnd,
+	};
+
+	struct Record
+	{
+		RecordType  type;
+		unsigned    query;
+		unsigned    frame;
+		const char *label;
+		unsigned    texture;
+	};
+
+private:
+	void push(RecordType type, unsigned texture);
+	void collect();
+
+private:
+	std::deque<Record>    mPending;
+	std::vector<unsigned> mFreeQueries;
+	bool                  mIsEnabled;
+	unsigned              mFrame;
+	const char           *mLabel;
+	std::uint64_t         mLastTimestamp;
+	GpuStats              mCurrent;
+	GpuStats              mStats;
+};
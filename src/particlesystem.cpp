@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include <GL/glew.h>
+
+#include "glcheck.hpp"
+#include "particlesystem.hpp"
+
+namespace
+{
+// world units per second squared, the y axis points down
+const float Gravity = 200.f;
+
+// half the side of the square drawn for a particle
+const float ParticleSize = 2.f;
+
+const unsigned WorkGroupSize = 256;
+
+// longest step simulated at once, a stalled frame doesn't throw
+// the particles away.
+const float MaxStep = 0.25f;
+
+// NOTE: std430 layout, the vec4 is aligned on 16 bytes.
+struct Particle
+{
+	glm::vec2 position;
+	glm::vec2 velocity;
+	glm::vec4 color;
+	float life;
+	float lifetime;
+	glm::vec2 padding;
+};
+
+const std::string particleStruct =
+	"\nstruct Particle"
+	"\n{"
+	"\n	vec2 position;"
+	"\n	vec2 velocity;"
+	"\n	vec4 color;"
+	"\n	float life;"
+	"\n	float lifetime;"
+	"\n	vec2 padding;"
+	"\n};"
+	"\nlayout (std430, binding = 0) buffer Particles"
+	"\n{"
+	"\n	Particle particles[];"
+	"\n};";
+
+const std::string emitShader =
+	"\n#version 430 core"
+	"\nlayout (local_size_x = " + std::to_string(WorkGroupSize) + ") in;"
+	+ particleStruct +
+	"\nuniform uint First;"
+	"\nuniform uint Count;"
+	"\nuniform vec2 Position;"
+	"\nuniform vec4 Color;"
+	"\nuniform float Speed;"
+	"\nuniform float Lifetime;"
+	"\nuniform uint Seed;"
+	"\nuint hash(uint x)"
+	"\n{"
+	"\n	x ^= x >> 16;"
+	"\n	x *= 0x7feb352du;"
+	"\n	x ^= x >> 15;"
+	"\n	x *= 0x846ca68bu;"
+	"\n	x ^= x >> 16;"
+	"\n	return x;"
+	"\n}"
+	"\nfloat random(uint x)"
+	"\n{"
+	"\n	return float(hash(x)) / 4294967295.0;"
+	"\n}"
+	"\nvoid main()"
+	"\n{"
+	"\n	uint i = gl_GlobalInvocationID.x;"
+	"\n	if (i >= Count)"
+	"\n	{"
+	"\n		return;"
+	"\n	}"
+	"\n	uint index = (First + i) % uint(particles.length());"
+	"\n	float angle = random(Seed + i * 2u) * 6.2831853;"
+	"\n	float speed = Speed * (0.25 + 0.75 * random(Seed + i * 2u + 1u));"
+	"\n	particles[index].position = Position;"
+	"\n	particles[index].velocity = vec2(cos(angle), sin(angle)) * speed;"
+	"\n	particles[index].color = Color;"
+	"\n	particles[index].life = Lifetime;"
+	"\n	particles[index].lifetime = Lifetime;"
+	"\n}";
+
+const std::string updateShader =
+	"\n#version 430 core"
+	"\nlayout (local_size_x = " + std::to_string(WorkGroupSize) + ") in;"
+	+ particleStruct +
+	"\nconst vec2 Gravity = vec2(0.0, " + std::to_string(Gravity) + ");"
+	"\nuniform float DeltaTime;"
+	"\nvoid main()"
+	"\n{"
+	"\n	uint i = gl_GlobalInvocationID.x;"
+	"\n	if (i >= uint(particles.length()) || particles[i].life <= 0.0)"
+	"\n	{"
+	"\n		return;"
+	"\n	}"
+	"\n	vec2 velocity = particles[i].velocity + Gravity * DeltaTime;"
+	"\n	particles[i].velocity = velocity;"
+	"\n	particles[i].position += velocity * DeltaTime;"
+	"\n	particles[i].life -= DeltaTime;"
+	"\n}";
+
+const std::string vertexShader =
+	"\n#version 330 core"
+	"\nlayout (location = 0) in vec2 Position;"
+	"\nlayout (location = 1) in vec4 Color;"
+	"\nlayout (location = 2) in float Life;"
+	"\nlayout (location = 3) in float Lifetime;"
+	"\nout vec4 GeomColor;"
+	"\nout float GeomLife;"
+	"\nvoid main()"
+	"\n{"
+	"\n	GeomColor = vec4(Color.rgb, Color.a * clamp(Life / Lifetime, 0.0, 1.0));"
+	"\n	GeomLife = Life;"
+	"\n	gl_Position = vec4(Position, 0, 1);"
+	"\n}";
+
+// the dead particles are not expanded
+const std::string geometryShader =
+	"\n#version 330 core"
+	"\nlayout (points) in;"
+	"\nlayout (triangle_strip, max_vertices = 4) out;"
+	"\nin vec4 GeomColor[];"
+	"\nin float GeomLife[];"
+	"\nuniform mat4 Projection;"
+	"\nout vec2 FragUV;"
+	"\nout vec4 FragColor;"
+	"\nvoid main()"
+	"\n{"
+	"\n	if (GeomLife[0] <= 0.0)"
+	"\n	{"
+	"\n		return;"
+	"\n	}"
+	"\n	for (int i = 0; i < 4; i++)"
+	"\n	{"
+	"\n		vec2 unit = vec2(i >> 1, i & 1) * 2.0 - 1.0;"
+	"\n		FragUV = unit;"
+	"\n		FragColor = GeomColor[0];"
+	"\n		gl_Position = Projection * vec4("
+	"\n			gl_in[0].gl_Position.xy + unit * " + std::to_string(ParticleSize) + ", 0, 1);"
+	"\n		EmitVertex();"
+	"\n	}"
+	"\n	EndPrimitive();"
+	"\n}";
+
+const std::string fragmentShader =
+	"\n#version 330 core"
+	"\nin vec2 FragUV;"
+	"\nin vec4 FragColor;"
+	"\nlayout (location = 0) out vec4 OutColor;"
+	"\nvoid main()"
+	"\n{"
+	"\n	float falloff = 1.0 - smoothstep(0.5, 1.0, length(FragUV));"
+	"\n	OutColor = vec4(FragColor.rgb, FragColor.a * falloff);"
+	"\n}";
+}
+
+ParticleSystem::ParticleSystem(unsigned capacity)
+	: mCapacity(capacity)
+	, mBuffer(0)
+	, mNext(0)
+	, mSeed(0)
+	, mIsCreated(false)
+	, mIsSupported(false)
+	, mPending{ 0.f, {} }
+	, mIsActive(false)
+{
+}
+
+ParticleSystem::~ParticleSystem()
+{
+	if (mBuffer)
+	{
+		glCheck(glDeleteBuffers(1, &mBuffer));
+	}
+}
+
+void
+ParticleSystem::emit(glm::vec2 position, unsigned count, Color color,
+		     float speed, float lifetime)
+{
+	if (!count || lifetime <= 0.f)
+	{
+		return;
+	}
+	mPending.emissions.push_back({ position, count, color, speed, lifetime });
+
+	// the farthest a particle can go, falling from the top speed
+	const float reach = speed * lifetime
+		+ 0.5f * Gravity * lifetime * lifetime
+		+ ParticleSize;
+	mEffects.push_back({
+		FloatRect(position - glm::vec2(reach), glm::vec2(reach * 2.f)),
+		lifetime });
+	mIsActive = true;
+}
+
+void
+ParticleSystem::update(float dt)
+{
+	// the time doesn't pile up while there's nothing to move
+	if (!mEffects.empty())
+	{
+		mPending.dt += dt;
+	}
+
+	// NOTE: the bounds include the effects ending in this update,
+	// the last frame erases them.
+	mIsActive = !mEffects.empty();
+	glm::vec2 low(0.f), high(0.f);
+	for (std::size_t i = 0; i < mEffects.size(); i++)
+	{
+		const FloatRect &bounds = mEffects[i].bounds;
+		low = i ? glm::min(low, bounds.pos) : bounds.pos;
+		high = i ? glm::max(high, bounds.pos + bounds.size) : bounds.pos + bounds.size;
+	}
+	mBounds = FloatRect(low, high - low);
+
+	for (auto &effect : mEffects)
+	{
+		effect.life -= dt;
+	}
+	mEffects.erase(
+		std::remove_if(mEffects.begin(), mEffects.end(),
+			       [](const Effect &effect) { return effect.life <= 0.f; }),
+		mEffects.end());
+}
+
+bool
+ParticleSystem::isActive() const
+{
+	return mIsActive;
+}
+
+FloatRect
+ParticleSystem::getBounds() const
+{
+	return mBounds;
+}
+
+ParticleSystem::Step
+ParticleSystem::takeStep()
+{
+	Step step{ mPending.dt, {} };
+	std::swap(step.emissions, mPending.emissions);
+	mPending.dt = 0.f;
+	return step;
+}
+
+void
+ParticleSystem::create()
+{
+	mIsCreated = true;
+	mIsSupported = GLEW_VERSION_4_3 && mCapacity;
+	if (!mIsSupported)
+	{
+		return;
+	}
+
+	mEmitShader.attach(emitShader, ShaderType::Compute);
+	mEmitShader.link();
+	mEmitFirst = mEmitShader.getUniform("First");
+	mEmitCount = mEmitShader.getUniform("Count");
+	mEmitPosition = mEmitShader.getUniform("Position");
+	mEmitColor = mEmitShader.getUniform("Color");
+	mEmitSpeed = mEmitShader.getUniform("Speed");
+	mEmitLifetime = mEmitShader.getUniform("Lifetime");
+	mEmitSeed = mEmitShader.getUniform("Seed");
+
+	mUpdateShader.attach(updateShader, ShaderType::Compute);
+	mUpdateShader.link();
+	mDeltaTime = mUpdateShader.getUniform("DeltaTime");
+
+	// the storage buffer is the vertex buffer of the pipeline
+	mPipeline.create(
+		vertexShader, fragmentShader, {
+			{ 0, 2, GL_FLOAT, false, offsetof(Particle, position) },
+			{ 1, 4, GL_FLOAT, false, offsetof(Particle, color) },
+			{ 2, 1, GL_FLOAT, false, offsetof(Particle, life) },
+			{ 3, 1, GL_FLOAT, false, offsetof(Particle, lifetime) },
+		},
+		sizeof(Particle),
+		0,
+		geometryShader);
+
+	// all the particles start dead
+	const std::vector<Particle> particles(mCapacity, Particle{});
+	glCheck(glGenBuffers(1, &mBuffer));
+	glCheck(glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffer));
+	glCheck(glBufferData(GL_SHADER_STORAGE_BUFFER,
+			     particles.size() * sizeof(Particle),
+			     particles.data(),
+			     GL_DYNAMIC_COPY));
+	glCheck(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+}
+
+bool
+ParticleSystem::simulate(const Step &step)
+{
+	if (!mIsCreated)
+	{
+		create();
+	}
+	if (!mIsSupported)
+	{
+		return false;
+	}
+
+	glCheck(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mBuffer));
+
+	// the new particles replace the oldest ones
+	if (!step.emissions.empty())
+	{
+		Shader::bind(&mEmitShader);
+		for (const auto &emission : step.emissions)
+		{
+			const unsigned count = std::min(emission.count, mCapacity);
+			mEmitFirst.set(mNext);
+			mEmitCount.set(count);
+			mEmitPosition.set(emission.position);
+			mEmitColor.set(glm::vec4(emission.color));
+			mEmitSpeed.set(emission.speed);
+			mEmitLifetime.set(emission.lifetime);
+			mEmitSeed.set(mSeed);
+			glCheck(glDispatchCompute((count + WorkGroupSize - 1) / WorkGroupSize, 1, 1));
+			mNext = (mNext + count) % mCapacity;
+			mSeed += count * 2;
+		}
+		glCheck(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+	}
+
+	Shader::bind(&mUpdateShader);
+	mDeltaTime.set(std::min(step.dt, MaxStep));
+	glCheck(glDispatchCompute((mCapacity + WorkGroupSize - 1) / WorkGroupSize, 1, 1));
+
+	// the buffer is read back as vertices
+	glCheck(glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT));
+	return true;
+}
+
+void
+ParticleSystem::draw(const glm::mat4 &projection)
+{
+	mPipeline.bind(mBuffer);
+	mPipeline.setProjection(projection);
+	glCheck(glDrawArrays(GL_POINTS, 0, mCapacity));
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "color.hpp"
+#include "pipeline.hpp"
+#include "rect.hpp"
+#include "shader.hpp"
+
+/**
+ * Particles simulated and drawn by the GPU.
+ *
+ * The particles live in a shader storage buffer: a compute shader
+ * moves them and they're drawn straight from the buffer as points
+ * expanded by a geometry shader, so they cost no CPU update and no
+ * upload. The CPU only queues the emissions and the elapsed time,
+ * they're run by RenderTarget::draw() on the thread owning the
+ * context, where the buffers are created.
+ *
+ * It needs OpenGL 4.3, without it the particles are not drawn.
+ */
+class ParticleSystem
+{
+public:
+	/**
+	 * @param[in] capacity maximum number of particles alive, the
+	 *            oldest ones are replaced when it's exceeded.
+	 */
+	explicit ParticleSystem(unsigned capacity);
+	~ParticleSystem();
+
+	ParticleSystem(const ParticleSystem &) = delete;
+	ParticleSystem(ParticleSystem &&) noexcept = delete;
+	ParticleSystem& operator=(const ParticleSystem &) = delete;
+	ParticleSystem& operator=(ParticleSystem &&) noexcept = delete;
+
+	/**
+	 * Emit @count particles from @position in random directions.
+	 *
+	 * @param[in] position world space origin.
+	 * @param[in] count number of particles.
+	 * @param[in] color initial color, it fades out with the life.
+	 * @param[in] speed maximum speed in units per second.
+	 * @param[in] lifetime life of the particles in seconds.
+	 */
+	void emit(glm::vec2 position, unsigned count, Color color,
+		  float speed, float lifetime);
+
+	/**
+	 * Advance the simulation by @dt seconds, it's run on the next
+	 * draw.
+	 *
+	 * @param[in] dt Elapsed time in seconds.
+	 */
+	void update(float dt);
+
+	/**
+	 * Check if some particles can be alive, or were alive before
+	 * the last update.
+	 */
+	bool isActive() const;
+
+	/**
+	 * Get a world space box containing the particles since the
+	 * last update, report it with RenderTarget::invalidate().
+	 */
+	FloatRect getBounds() const;
+
+private:
+	friend class FramePacket;
+	friend class RenderTarget;
+
+	struct Emission
+	{
+		glm::vec2 position;
+		unsigned  count;
+		Color     color;
+		float     speed;
+		float     lifetime;
+	};
+
+	struct Step
+	{
+		float dt;
+		std::vector<Emission> emissions;
+	};
+
+	struct Effect
+	{
+		FloatRect bounds;
+		float     life;
+	};
+
+private:
+	Step takeStep();
+	bool simulate(const Step &step);
+	void draw(const glm::mat4 &projection);
+	void create();
+
+private:
+	unsigned      mCapacity;
+	unsigned      mBuffer;
+	unsigned      mNext;
+	unsigned      mSeed;
+	bool          mIsCreated;
+	bool          mIsSupported;
+	Shader        mEmitShader;
+	Shader        mUpdateShader;
+	ShaderUniform mEmitFirst;
+	ShaderUniform mEmitCount;
+	ShaderUniform mEmitPosition;
+	ShaderUniform mEmitColor;
+	ShaderUniform mEmitSpeed;
+	ShaderUniform mEmitLifetime;
+	ShaderUniform mEmitSeed;
+	ShaderUniform mDeltaTime;
+	Pipeline      mPipeline;
+
+	Step                mPending;
+	std::vector<Effect> mEffects;
+	FloatRect           mBounds;
+	bool                mIsActive;
+};
@@ -0,0 +1,124 @@
+#include <cassert>
+
+#include <GL/glew.h>
+
+#include "glcheck.hpp"
+#include "pipeline.hpp"
+
+Pipeline::Pipeline()
+	: mStride(0)
+	, mVAO(0)
+	, mVertexBuffer(0)
+	, mBufferOffset(0)
+	, mLastProjection(1.f)
+	, mHasProjection(false)
+{
+}
+
+Pipeline::~Pipeline()
+{
+	if (mVAO)
+	{
+		glCheck(glBindVertexArray(0));
+		glCheck(glDeleteVertexArrays(1, &mVAO));
+	}
+}
+
+void
+Pipeline::create(const std::string &vertexShader,
+		 const std::string &fragmentShader,
+		 std::vector<VertexAttribute> layout,
+		 std::size_t stride,
+		 unsigned textureCount,
+		 const std::string &geometryShader)
+{
+	mShader.attach(vertexShader, ShaderType::Vertex);
+	if (!geometryShader.empty())
+	{
+		mShader.attach(geometryShader, ShaderType::Geometry);
+	}
+	mShader.attach(fragmentShader, ShaderType::Fragment);
+	mShader.link();
+
+	// the samplers never change, set them once
+	Shader::bind(&mShader);
+	for (unsigned unit = 0; unit < textureCount; unit++)
+	{
+		mShader.getUniform("Textures[" + std::to_string(unit) + "]")
+			.set(static_cast<int>(unit));
+	}
+	mProjection = mShader.getUniform("Projection");
+	mHasProjection = false;
+
+	mLayout = std::move(layout);
+	mStride = stride;
+	glCheck(glGenVertexArrays(1, &mVAO));
+	glCheck(glBindVertexArray(mVAO));
+	for (const auto &attribute : mLayout)
+	{
+		glCheck(glEnableVertexAttribArray(attribute.index));
+		glCheck(glVertexAttribDivisor(attribute.index, attribute.divisor));
+	}
+}
+
+void
+Pipeline::bind(unsigned vertexBuffer, std::size_t offset)
+{
+	assert(mVAO && "Pipeline not created");
+
+	Shader::bind(&mShader);
+	glCheck(glBindVertexArray(mVAO));
+	if (mVertexBuffer != vertexBuffer || mBufferOffset != offset)
+	{
+		setupLayout(vertexBuffer, offset);
+	}
+}
+
+void
+Pipeline::invalidate()
+{
+	mVertexBuffer = 0;
+	mBufferOffset = 0;
+}
+
+void
+Pipeline::setProjection(const glm::mat4 &projection)
+{
+	if (!mHasProjection || mLastProjection != projection)
+	{
+		mHasProjection = true;
+		mLastProjection = projection;
+		mProjection.set(projection);
+	}
+}
+
+void
+Pipeline::setupLayout(unsigned vertexBuffer, std::size_t offset)
+{
+	mVertexBuffer = vertexBuffer;
+	mBufferOffset = offset;
+	glCheck(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
+	for (const auto &attribute : mLayout)
+	{
+		const auto pointer = reinterpret_cast<GLvoid*>(offset + attribute.offset);
+		if (attribute.integer)
+		{
+			glCheck(glVertexAttribIPointer(
+					attribute.index,
+					attribute.size,
+					attribute.type,
+					mStride,
+					pointer));
+		}
+		else
+		{
+			glCheck(glVertexAttribPointer(
+					attribute.index,
+					attribute.size,
+					attribute.type,
+					attribute.normalized ? GL_TRUE : GL_FALSE,
+					mStride,
+					pointer));
+		}
+	}
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+
+struct VertexAttribute
+{
+	unsigned    index;
+	int         size;
+	unsigned    type;
+	bool        normalized;
+	std::size_t offset;
+	unsigned    divisor = 0;
+	bool        integer = false;
+};
+
+/**
+ * A shader program bundled with a fully configured vertex array
+ * object and the cached locations and values of its uniforms.
+ */
+class Pipeline
+{
+public:
+	Pipeline();
+	~Pipeline();
+
+	Pipeline(const Pipeline &) = delete;
+	Pipeline(Pipeline &&) noexcept = delete;
+	Pipeline& operator=(const Pipeline &) = delete;
+	Pipeline& operator=(Pipeline &&) noexcept = delete;
+
+	/**
+	 * Build the program and the vertex array object.
+	 *
+	 * @param[in] vertexShader source of the vertex shader.
+	 * @param[in] fragmentShader source of the fragment shader.
+	 * @param[in] layout attributes of the vertex format.
+	 * @param[in] stride size in bytes of a vertex.
+	 * @param[in] textureCount size of the Textures sampler array,
+	 *            the sampler N is bound to the texture unit N.
+	 * @param[in] geometryShader source of the geometry shader,
+	 *            none if empty.
+	 */
+	void create(const std::string &vertexShader,
+		    const std::string &fragmentShader,
+		    std::vector<VertexAttribute> layout,
+		    std::size_t stride,
+		    unsigned textureCount = 1,
+		    const std::string &geometryShader = {});
+
+	/**
+	 * Bind the program and the vertex array object. The vertex
+	 * attributes are specified again only if @vertexBuffer and
+	 * @offset are not the ones they point to.
+	 *
+	 * @param[in] vertexBuffer OpenGL name of the vertex buffer.
+	 * @param[in] offset offset in bytes of the first vertex.
+	 */
+	void bind(unsigned vertexBuffer, std::size_t offset = 0);
+
+	/**
+	 * Forget the vertex buffer the attributes point to, the next
+	 * bind() specifies them again. Needed when the buffer is
+	 * replaced, OpenGL can give the new one the same name.
+	 */
+	void invalidate();
+
+	/**
+	 * Set the projection matrix, it's uploaded only when it
+	 * differs from the last one set.
+	 *
+	 * @param[in] projection projection matrix.
+	 */
+	void setProjection(const glm::mat4 &projection);
+
+private:
+	void setupLayout(unsigned vertexBuffer, std::size_t offset);
+
+private:
+	Shader                       mShader;
+	ShaderUniform                mProjection;
+	std::vector<VertexAttribute> mLayout;
+	std::size_t                  mStride;
+	unsigned                     mVAO;
+	unsigned                     mVertexBuffer;
+	std::size_t                  mBufferOffset;
+	glm::mat4                    mLastProjection;
+	bool                         mHasProjection;
+};
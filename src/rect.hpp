@@ -13,6 +13,7 @@ struct Rect
 	explicit Rect(const Rect<U> &rectangle);
 
 	bool contains(T point) const;
+	bool intersects(const Rect &other) const;
 
 	T pos;
 	T size;
@@ -53,6 +54,14 @@ Rect<T>::contains(T point) const
 		&& pos.y <= point.y && point.y < pos.y + size.y;
 }
 
+template <typename T>
+bool
+Rect<T>::intersects(const Rect &other) const
+{
+	return pos.x < other.pos.x + other.size.x && other.pos.x < pos.x + size.x
+		&& pos.y < other.pos.y + other.size.y && other.pos.y < pos.y + size.y;
+}
+
 template <typename T>
 constexpr bool
 operator==(const Rect<T> &lhs, const Rect<T> &rhs)
@@ -1,3 +1,4 @@
+#include "rect.hpp"
 #include "rectangle.hpp"
 #include "rendertarget.hpp"
 
@@ -34,24 +35,16 @@ Rectangle::setColor(Color color)
 void
 Rectangle::draw(RenderTarget &target, glm::vec2 position) const
 {
-	const glm::vec2 units[4] = {
-		{ 0.f, 0.f },
-		{ 0.f, 1.f },
-		{ 1.f, 0.f },
-		{ 1.f, 1.f },
-	};
-
-	Vertex vertices[4];
-	for (int i = 0; i < 4; i++)
+	if (!target.isVisible(FloatRect(position, mSize)))
 	{
-		vertices[i].pos = units[i] * mSize + position;
-		vertices[i].uv = units[i];
-		vertices[i].color = mColor;
+		return;
 	}
 
 	target.setTexture(nullptr);
-	auto base = target.getPrimIndex(6, 4);
-	const std::uint16_t indices[] = { 0, 1, 2, 1, 3, 2 };
-	target.addIndices(base, indices + 0, indices + 6);
-	target.addVertices(vertices + 0, vertices + 4);
+	Quad *quad = target.getQuadArray(1);
+	quad->pos = position;
+	quad->size = mSize;
+	quad->uvPos = glm::vec2(0.f);
+	quad->uvSize = glm::vec2(1.f);
+	quad->color = mColor;
 }
@@ -1,11 +1,18 @@
-#include <iostream>
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <iostream>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <variant>
 
 #include <GL/glew.h>
 
 #include "color.hpp"
 #include "glcheck.hpp"
 #include "rendertarget.hpp"
+#include "rendertexture.hpp"
 #include "window.hpp"
 
 namespace
@@ -15,55 +22,287 @@ const char *vertexShader =
 	"\nlayout (location = 0) in vec2 Position;"
 	"\nlayout (location = 1) in vec2 UV;"
 	"\nlayout (location = 2) in vec4 Color;"
+	"\nlayout (location = 3) in uint Texture;"
 	"\nuniform mat4 Projection;"
 	"\nout vec2 FragUV;"
 	"\nout vec4 FragColor;"
+	"\nflat out uint FragTexture;"
 	"\nvoid main()"
 	"\n{"
 	"\n	FragUV = UV;"
 	"\n	FragColor = Color;"
+	"\n	FragTexture = Texture;"
 	"\n	gl_Position = Projection * vec4(Position, 0, 1);"
 	"\n}";
 
+const char *quadVertexShader =
+	"\n#version 330 core"
+	"\nlayout (location = 0) in vec2 Position;"
+	"\nlayout (location = 1) in vec2 Size;"
+	"\nlayout (location = 2) in vec2 UVPosition;"
+	"\nlayout (location = 3) in vec2 UVSize;"
+	"\nlayout (location = 4) in vec4 Color;"
+	"\nlayout (location = 5) in uint Texture;"
+	"\nuniform mat4 Projection;"
+	"\nout vec2 FragUV;"
+	"\nout vec4 FragColor;"
+	"\nflat out uint FragTexture;"
+	"\nvoid main()"
+	"\n{"
+	"\n	vec2 unit = vec2(gl_VertexID >> 1, gl_VertexID & 1);"
+	"\n	FragUV = UVPosition + UVSize * unit;"
+	"\n	FragColor = Color;"
+	"\n	FragTexture = Texture;"
+	"\n	gl_Position = Projection * vec4(Position + Size * unit, 0, 1);"
+	"\n}";
+
+// the quads as points, the corners are expanded by the geometry
+// shader in the same order as the instanced ones.
+const char *pointVertexShader =
+	"\n#version 330 core"
+	"\nlayout (location = 0) in vec2 Position;"
+	"\nlayout (location = 1) in vec2 Size;"
+	"\nlayout (location = 2) in vec2 UVPosition;"
+	"\nlayout (location = 3) in vec2 UVSize;"
+	"\nlayout (location = 4) in vec4 Color;"
+	"\nlayout (location = 5) in uint Texture;"
+	"\nout vec2 GeomSize;"
+	"\nout vec2 GeomUVPosition;"
+	"\nout vec2 GeomUVSize;"
+	"\nout vec4 GeomColor;"
+	"\nflat out uint GeomTexture;"
+	"\nvoid main()"
+	"\n{"
+	"\n	GeomSize = Size;"
+	"\n	GeomUVPosition = UVPosition;"
+	"\n	GeomUVSize = UVSize;"
+	"\n	GeomColor = Color;"
+	"\n	GeomTexture = Texture;"
+	"\n	gl_Position = vec4(Position, 0, 1);"
+	"\n}";
+
+const char *pointGeometryShader =
+	"\n#version 330 core"
+	"\nlayout (points) in;"
+	"\nlayout (triangle_strip, max_vertices = 4) out;"
+	"\nin vec2 GeomSize[];"
+	"\nin vec2 GeomUVPosition[];"
+	"\nin vec2 GeomUVSize[];"
+	"\nin vec4 GeomColor[];"
+	"\nflat in uint GeomTexture[];"
+	"\nuniform mat4 Projection;"
+	"\nout vec2 FragUV;"
+	"\nout vec4 FragColor;"
+	"\nflat out uint FragTexture;"
+	"\nvoid main()"
+	"\n{"
+	"\n	for (int i = 0; i < 4; i++)"
+	"\n	{"
+	"\n		vec2 unit = vec2(i >> 1, i & 1);"
+	"\n		FragUV = GeomUVPosition[0] + GeomUVSize[0] * unit;"
+	"\n		FragColor = GeomColor[0];"
+	"\n		FragTexture = GeomTexture[0];"
+	"\n		gl_Position = Projection"
+	"\n			* vec4(gl_in[0].gl_Position.xy + GeomSize[0] * unit, 0, 1);"
+	"\n		EmitVertex();"
+	"\n	}"
+	"\n	EndPrimitive();"
+	"\n}";
+
+// NOTE: GLSL 3.30 allows only constant indices in sampler arrays,
+// the switch selects the sampler with a literal index. The texture
+// index is flat so the branch is uniform across a primitive.
 const char *fragmentShader =
 	"\n#version 330 core"
 	"\nin vec2 FragUV;"
 	"\nin vec4 FragColor;"
-	"\nuniform sampler2D Texture;"
+	"\nflat in uint FragTexture;"
+	"\nuniform sampler2D Textures[8];"
 	"\nlayout (location = 0) out vec4 OutColor;"
+	"\nvec4 sampleTexture(vec2 uv)"
+	"\n{"
+	"\n	switch (FragTexture)"
+	"\n	{"
+	"\n	case 1u: return texture(Textures[1], uv);"
+	"\n	case 2u: return texture(Textures[2], uv);"
+	"\n	case 3u: return texture(Textures[3], uv);"
+	"\n	case 4u: return texture(Textures[4], uv);"
+	"\n	case 5u: return texture(Textures[5], uv);"
+	"\n	case 6u: return texture(Textures[6], uv);"
+	"\n	case 7u: return texture(Textures[7], uv);"
+	"\n	default: return texture(Textures[0], uv);"
+	"\n	}"
+	"\n}"
 	"\nvoid main()"
 	"\n{"
-	"\n	OutColor = FragColor * texture(Texture, FragUV.st);"
+	"\n	OutColor = FragColor * sampleTexture(FragUV.st);"
 	"\n}";
 
+const int TextureUnit = 0;
+
+// size of the sampler array of the fragment shader
+const unsigned MaxTextureUnits = 8;
+
+const std::size_t VertexSegmentSize = 1 << 20;
+const std::size_t IndexSegmentSize = 1 << 18;
+
+// the shared quad index buffer addresses the whole 16-bit range
+const unsigned MaxQuadsPerDraw = (UINT16_MAX + 1) / 4;
+
+// Layout of the 64-bit channel sort key, from the most significant
+// field: layer (16 bits), blend mode (8 bits), shader (8 bits) and
+// texture group (32 bits). The shader field selects the pipeline,
+// the textures of a group are bound together to different units.
+const unsigned LayerShift = 48;
+const unsigned BlendShift = 40;
+const unsigned ShaderShift = 32;
+const unsigned MaxLayer = 0xFFFF;
+
+enum PipelineID : unsigned
+{
+	TrianglePipeline,
+	QuadListPipeline,
+	QuadPipeline,
+};
+
+std::uint64_t
+makeSortKey(unsigned layer, BlendMode blend, unsigned shader, unsigned group)
+{
+	return static_cast<std::uint64_t>(layer) << LayerShift
+		| static_cast<std::uint64_t>(blend) << BlendShift
+		| static_cast<std::uint64_t>(shader & 0xFF) << ShaderShift
+		| static_cast<std::uint64_t>(group);
+}
+
+unsigned
+getPipeline(std::uint64_t key)
+{
+	return (key >> ShaderShift) & 0xFF;
+}
+
+BlendMode
+getBlendMode(std::uint64_t key)
+{
+	return static_cast<BlendMode>((key >> BlendShift) & 0xFF);
+}
+
+unsigned
+getLayer(std::uint64_t key)
+{
+	return key >> LayerShift;
+}
+
+unsigned
+getGroup(std::uint64_t key)
+{
+	return key & 0xFFFFFFFF;
+}
+
+// the upper layers are nearer, the first one is at the far plane
+float
+getDepth(unsigned layer)
+{
+	return 1.f - 2.f * (layer + 1) / (MaxLayer + 2);
+}
+
+// NOTE: the values out of range are clamped silently in release
+// builds, see VertexFormat::Compact.
+std::int16_t
+compressPosition(float value)
+{
+	assert(value >= INT16_MIN && value <= INT16_MAX
+	       && "position out of the compact vertex range");
+	return static_cast<std::int16_t>(
+		std::clamp(std::round(value), float(INT16_MIN), float(INT16_MAX)));
+}
+
+std::uint16_t
+compressUV(float value)
+{
+	assert(value >= 0.f && value <= 1.f
+	       && "texture coordinate out of the compact vertex range");
+	return static_cast<std::uint16_t>(
+		std::clamp(value, 0.f, 1.f) * UINT16_MAX + 0.5f);
+}
+
+CompactVertex
+compress(const Vertex &vertex)
+{
+	return {
+		compressPosition(vertex.pos.x),
+		compressPosition(vertex.pos.y),
+		compressUV(vertex.uv.x),
+		compressUV(vertex.uv.y),
+		vertex.color,
+	};
+}
+
+void
+applyBlendMode(BlendMode mode)
+{
+	switch (mode)
+	{
+	case BlendMode::Alpha:
+		glCheck(glEnable(GL_BLEND));
+		glCheck(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+		break;
+	case BlendMode::Add:
+		glCheck(glEnable(GL_BLEND));
+		glCheck(glBlendFunc(GL_SRC_ALPHA, GL_ONE));
+		break;
+	case BlendMode::Multiply:
+		glCheck(glEnable(GL_BLEND));
+		glCheck(glBlendFunc(GL_DST_COLOR, GL_ONE_MINUS_SRC_ALPHA));
+		break;
+	case BlendMode::None:
+		glCheck(glDisable(GL_BLEND));
+		break;
+	}
+}
 }
 
 RenderTarget::RenderTarget()
-	: mIsBatching(false)
+	: mWindowSize(0, 0)
+	, mBackbuffer(nullptr)
+	, mRenderTexture(nullptr)
+	, mPacket(nullptr)
+	, mProfileLabel(nullptr)
+	, mIsDamaged(false)
+	, mIsFullyDamaged(true)
+	, mIsScissored(false)
+	, mVertexCount(0)
+	, mIndexCount(0)
+	, mIndexSize(sizeof(std::uint16_t))
+	, mQuadCount(0)
+	, mQuadVertexCount(0)
+	, mGeneration(0)
+	, mBatchSerial(0)
+	, mTextureCount(0)
+	, mTextureUnits(MaxTextureUnits)
+	, mLayer(0)
+	, mBlendMode(BlendMode::Alpha)
+	, mVertexFormat(VertexFormat::Standard)
+	, mQuadExpansion(QuadExpansion::Instancing)
+	, mIsDepthSorted(false)
+	, mHasOpaque(false)
+	, mProjection(1.f)
+	, mIsBatching(false)
 	, mChannelList(nullptr)
 	, mChannelTail(&mChannelList)
 	, mCurrent(nullptr)
 	, mFreeChannels(nullptr)
-	, mVBO(0)
-	, mEBO(0)
-	, mVAO(0)
+	, mStreamGeneration(0)
+	, mQuadIndices(0)
+	, mQuadDrawFirst(0)
+	, mQuadDrawCount(0)
 {
 }
 
 RenderTarget::~RenderTarget()
 {
-	if (mVAO)
-	{
-		glCheck(glBindVertexArray(0));
-		glCheck(glDeleteVertexArrays(1, &mVAO));
-	}
-	if (mEBO)
-	{
-		glCheck(glDeleteBuffers(1, &mEBO));
-	}
-	if (mVBO)
+	if (mQuadIndices)
 	{
-		glCheck(glDeleteBuffers(1, &mVBO));
+		glCheck(glDeleteBuffers(1, &mQuadIndices));
 	}
 
 	beginBatch();
@@ -77,24 +316,194 @@ RenderTarget::~RenderTarget()
 }
 
 void
-RenderTarget::use(const Window &window)
+RenderTarget::use(const Window &window, RenderTexture *backbuffer)
 {
 	mWhiteTexture.create(1, 1, &Color::White);
-	mShader.attach(vertexShader, ShaderType::Vertex);
-	mShader.attach(fragmentShader, ShaderType::Fragment);
-	mShader.link();
+	mPipeline.create(
+		vertexShader, fragmentShader, {
+			{ 0, 2, GL_FLOAT, false, offsetof(Vertex, pos) },
+			{ 1, 2, GL_FLOAT, false, offsetof(Vertex, uv) },
+			{ 2, 4, GL_UNSIGNED_BYTE, true, offsetof(Vertex, color) },
+			{ 3, 1, GL_UNSIGNED_INT, false, offsetof(Vertex, texture), 0, true },
+		},
+		sizeof(Vertex),
+		MaxTextureUnits);
+	// NOTE: the compact vertices don't carry the texture unit,
+	// it's a constant attribute set before each draw.
+	mCompactPipeline.create(
+		vertexShader, fragmentShader, {
+			{ 0, 2, GL_SHORT, false, offsetof(CompactVertex, x) },
+			{ 1, 2, GL_UNSIGNED_SHORT, true, offsetof(CompactVertex, u) },
+			{ 2, 4, GL_UNSIGNED_BYTE, true, offsetof(CompactVertex, color) },
+		},
+		sizeof(CompactVertex),
+		MaxTextureUnits);
+	mQuadPipeline.create(
+		quadVertexShader, fragmentShader, {
+			{ 0, 2, GL_FLOAT, false, offsetof(Quad, pos), 1 },
+			{ 1, 2, GL_FLOAT, false, offsetof(Quad, size), 1 },
+			{ 2, 2, GL_FLOAT, false, offsetof(Quad, uvPos), 1 },
+			{ 3, 2, GL_FLOAT, false, offsetof(Quad, uvSize), 1 },
+			{ 4, 4, GL_UNSIGNED_BYTE, true, offsetof(Quad, color), 1 },
+			{ 5, 1, GL_UNSIGNED_INT, false, offsetof(Quad, texture), 1, true },
+		},
+		sizeof(Quad),
+		MaxTextureUnits);
+	mPointPipeline.create(
+		pointVertexShader, fragmentShader, {
+			{ 0, 2, GL_FLOAT, false, offsetof(Quad, pos) },
+			{ 1, 2, GL_FLOAT, false, offsetof(Quad, size) },
+			{ 2, 2, GL_FLOAT, false, offsetof(Quad, uvPos) },
+			{ 3, 2, GL_FLOAT, false, offsetof(Quad, uvSize) },
+			{ 4, 4, GL_UNSIGNED_BYTE, true, offsetof(Quad, color) },
+			{ 5, 1, GL_UNSIGNED_INT, false, offsetof(Quad, texture), 0, true },
+		},
+		sizeof(Quad),
+		MaxTextureUnits,
+		pointGeometryShader);
 
-	glm::vec2 size = window.getSize();
+	mWindowSize = window.getSize();
+	glm::vec2 size = mWindowSize;
 	mDefaultCamera.setCenter(size * 0.5f);
 	mDefaultCamera.setSize(size);
 	mCamera = mDefaultCamera;
+	mCameraBounds = mCamera.getBounds();
+
+	mBackbuffer = backbuffer;
+	setRenderTexture(nullptr);
 
 	glCheck(glEnable(GL_CULL_FACE));
-	glCheck(glEnable(GL_BLEND));
-	glCheck(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-	glCheck(glGenVertexArrays(1, &mVAO));
-	glCheck(glGenBuffers(1, &mVBO));
-	glCheck(glGenBuffers(1, &mEBO));
+	applyBlendMode(BlendMode::Alpha);
+	mVertexStream.create(GL_ARRAY_BUFFER, VertexSegmentSize);
+	mIndexStream.create(GL_ELEMENT_ARRAY_BUFFER, IndexSegmentSize);
+
+	// build the immutable index buffer shared by all the quads
+	std::vector<std::uint16_t> indices;
+	indices.reserve(MaxQuadsPerDraw * 6);
+	for (unsigned base = 0; base < MaxQuadsPerDraw * 4; base += 4)
+	{
+		for (unsigned index : { 0, 1, 2, 1, 3, 2 })
+		{
+			indices.push_back(base + index);
+		}
+	}
+	glCheck(glGenBuffers(1, &mQuadIndices));
+	glCheck(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mQuadIndices));
+	glCheck(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+			     indices.size() * sizeof(indices[0]),
+			     indices.data(),
+			     GL_STATIC_DRAW));
+}
+
+void
+RenderTarget::record(const Window &window)
+{
+	mWindowSize = window.getSize();
+	glm::vec2 size = mWindowSize;
+	mDefaultCamera.setCenter(size * 0.5f);
+	mDefaultCamera.setSize(size);
+	mCamera = mDefaultCamera;
+	mCameraBounds = mCamera.getBounds();
+}
+
+bool
+RenderTarget::replay(const FramePacket &packet)
+{
+	mDamage = packet.mDamage;
+	mIsDamaged = packet.mIsDamaged;
+	mIsFullyDamaged = packet.mIsFullyDamaged;
+	if (!beginFrame())
+	{
+		// the textures are updated even if nothing is drawn, the
+		// next frames expect them.
+		for (const auto &command : packet.mCommands)
+		{
+			if (auto update = std::get_if<FramePacket::UpdateTexture>(&command))
+			{
+				uploadTexture(*update->texture, update->size,
+					      update->area, update->pixels.data());
+			}
+		}
+		return false;
+	}
+
+	for (const auto &command : packet.mCommands)
+	{
+		std::visit([this, &packet](const auto &c) {
+			using T = std::decay_t<decltype(c)>;
+			if constexpr (std::is_same_v<T, FramePacket::Clear>)
+			{
+				clear(c.color);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::Submit>)
+			{
+				// the packet is kept until the frame is drawn
+				merge(packet.mLists[c.list]);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::Draw>)
+			{
+				draw();
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::DrawRetained>)
+			{
+				draw(*c.batch, c.transform);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::DrawParticles>)
+			{
+				drawParticles(*c.particles, c.step);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::SetCamera>)
+			{
+				setCamera(c.camera);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::SetRenderTexture>)
+			{
+				// the dirty flag belongs to the recording target
+				if (mIsBatching)
+				{
+					draw();
+				}
+				bindRenderTexture(c.texture, c.size);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::SetProfileLabel>)
+			{
+				setProfileLabel(c.label);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::SetVertexFormat>)
+			{
+				setVertexFormat(c.format);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::SetTextureUnits>)
+			{
+				setTextureUnits(c.count);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::SetDepthSorting>)
+			{
+				setDepthSorting(c.enabled);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::SetQuadExpansion>)
+			{
+				setQuadExpansion(c.expansion);
+			}
+			else if constexpr (std::is_same_v<T, FramePacket::UpdateTexture>)
+			{
+				uploadTexture(*c.texture, c.size, c.area, c.pixels.data());
+			}
+		}, command);
+	}
+
+	// NOTE: the batch reads the vertices in place from the packet,
+	// it can't be left open past the frame.
+	if (mIsBatching)
+	{
+		draw();
+	}
+	endFrame();
+	if (packet.mIsPresented)
+	{
+		present();
+	}
+	return packet.mIsPresented;
 }
 
 const Camera&
@@ -113,232 +522,1426 @@ void
 RenderTarget::setCamera(const Camera &view)
 {
 	mCamera = view;
+	mCameraBounds = mCamera.getBounds();
+	if (mPacket)
+	{
+		mPacket->push(FramePacket::SetCamera{ view });
+	}
+}
+
+bool
+RenderTarget::isVisible(const FloatRect &bounds) const
+{
+	return mCameraBounds.intersects(bounds);
 }
 
 void
 RenderTarget::clear(Color color)
 {
+	if (mPacket)
+	{
+		mPacket->push(FramePacket::Clear{ color });
+		return;
+	}
+
 	glm::vec4 clearColor(color);
 	glCheck(glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a));
 	glCheck(glClear(GL_COLOR_BUFFER_BIT));
 }
 
 void
-RenderTarget::addLayer()
+RenderTarget::invalidate()
 {
-	// NOTE: by deleting the texture->channel association
-	// we force to build another set of channels.
-	mChannelMap.clear();
+	mIsFullyDamaged = true;
 }
 
 void
-RenderTarget::beginBatch()
+RenderTarget::invalidate(const FloatRect &bounds)
 {
-	mVertices.clear();
-	mChannelMap.clear();
-	*mChannelTail = mFreeChannels;
-	mFreeChannels = mChannelList;
-	mChannelList = mCurrent = nullptr;
-	mChannelTail = &mChannelList;
-}
+	// the damage is kept in framebuffer pixels, the camera can
+	// change before the frame is drawn.
+	const glm::mat4 &transform = mCamera.getTransform();
+	const glm::vec2 size(mWindowSize);
+	glm::vec2 low(size), high(0.f);
+	for (auto corner : {
+			bounds.pos,
+			bounds.pos + glm::vec2(bounds.size.x, 0.f),
+			bounds.pos + glm::vec2(0.f, bounds.size.y),
+			bounds.pos + bounds.size })
+	{
+		const glm::vec4 ndc = transform * glm::vec4(corner, 0.f, 1.f);
+		const glm::vec2 pixel = (glm::vec2(ndc.x, ndc.y) * 0.5f + 0.5f) * size;
+		low.x = std::min(low.x, pixel.x);
+		low.y = std::min(low.y, pixel.y);
+		high.x = std::max(high.x, pixel.x);
+		high.y = std::max(high.y, pixel.y);
+	}
 
-void
-RenderTarget::endBatch()
-{
-	mIndices.clear();
-	for (auto channel = mChannelList; channel; channel = channel->next)
+	if (mIsDamaged)
 	{
-		channel->idxOffset = mIndices.size() * sizeof(std::uint16_t);
-		mIndices.insert(mIndices.end(),
-				channel->idxBuffer.begin(),
-				channel->idxBuffer.end());
+		low.x = std::min(low.x, mDamage.pos.x);
+		low.y = std::min(low.y, mDamage.pos.y);
+		high.x = std::max(high.x, mDamage.pos.x + mDamage.size.x);
+		high.y = std::max(high.y, mDamage.pos.y + mDamage.size.y);
 	}
+	mDamage = FloatRect(low, high - low);
+	mIsDamaged = true;
 }
 
-void
-RenderTarget::draw()
+bool
+RenderTarget::clipDamage(glm::ivec2 &low, glm::ivec2 &high) const
 {
-	assert(mVAO && mVBO && mEBO && "OpenGL objects not initialized.");
-	const int textureUnit = 0;
+	// round outwards, the filtering can touch one more pixel
+	low = glm::ivec2(
+		std::max(static_cast<int>(std::floor(mDamage.pos.x)) - 1, 0),
+		std::max(static_cast<int>(std::floor(mDamage.pos.y)) - 1, 0));
+	high = glm::ivec2(
+		std::min(static_cast<int>(std::ceil(mDamage.pos.x + mDamage.size.x)) + 1,
+			 mWindowSize.x),
+		std::min(static_cast<int>(std::ceil(mDamage.pos.y + mDamage.size.y)) + 1,
+			 mWindowSize.y));
+	return low.x < high.x && low.y < high.y;
+}
 
-	if (!mChannelList)
+bool
+RenderTarget::beginFrame()
+{
+	glm::ivec2 low, high;
+	if (!mIsFullyDamaged && (!mIsDamaged || !clipDamage(low, high)))
 	{
-		return;
+		mIsDamaged = false;
+		return false;
 	}
 
-	if (mIsBatching)
+	// the damage is replayed with the packet, the state set
+	// before the frame too.
+	if (mPacket)
 	{
-		mIsBatching = false;
-		endBatch();
+		mPacket->mDamage = mDamage;
+		mPacket->mIsDamaged = mIsDamaged;
+		mPacket->mIsFullyDamaged = mIsFullyDamaged;
+		mPacket->push(FramePacket::SetCamera{ mCamera });
+		mPacket->push(FramePacket::SetVertexFormat{ mVertexFormat });
+		mPacket->push(FramePacket::SetTextureUnits{ mTextureUnits });
+		mPacket->push(FramePacket::SetDepthSorting{ mIsDepthSorted });
+		mPacket->push(FramePacket::SetQuadExpansion{ mQuadExpansion });
+		mPacket->push(FramePacket::SetProfileLabel{ mProfileLabel });
+		return true;
 	}
 
-	glCheck(glBindVertexArray(mVAO));
-
-	Shader::bind(&mShader);
-	ShaderUniform projection = mShader.getUniform("Projection");
-	ShaderUniform sampler = mShader.getUniform("Texture");
+	mIsScissored = !mIsFullyDamaged;
+	if (mIsScissored)
+	{
+		glCheck(glScissor(low.x, low.y, high.x - low.x, high.y - low.y));
+		if (!mRenderTexture)
+		{
+			glCheck(glEnable(GL_SCISSOR_TEST));
+		}
+	}
+	return true;
+}
 
-	sampler.set(textureUnit);
-	projection.set(mCamera.getTransform());
+void
+RenderTarget::endFrame()
+{
+	mIsDamaged = false;
+	mIsFullyDamaged = false;
+	if (mPacket)
+	{
+		return;
+	}
 
-	glCheck(glBindBuffer(GL_ARRAY_BUFFER, mVBO));
-	glCheck(glBufferData(GL_ARRAY_BUFFER,
-			     mVertices.size() * sizeof(mVertices[0]),
-			     mVertices.data(),
-			     GL_STREAM_DRAW));
+	mProfiler.endFrame();
+	mFrameSync.endFrame();
 
-	glCheck(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO));
-	glCheck(glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-			     mIndices.size() * sizeof(mIndices[0]),
-			     mIndices.data(),
-			     GL_STREAM_DRAW));
-
-	glCheck(glEnableVertexAttribArray(0));
-	glCheck(glVertexAttribPointer(
-			0, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			reinterpret_cast<GLvoid*>(offsetof(Vertex, pos))));
-	glCheck(glEnableVertexAttribArray(1));
-	glCheck(glVertexAttribPointer(
-			1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
-			reinterpret_cast<GLvoid*>(offsetof(Vertex, uv))));
-	glCheck(glEnableVertexAttribArray(2));
-	glCheck(glVertexAttribPointer(
-			2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
-			reinterpret_cast<GLvoid*>(offsetof(Vertex, color))));
+	glCheck(glDisable(GL_SCISSOR_TEST));
+	mIsScissored = false;
+}
 
-	const Texture *currentTexture = nullptr;
-	for (auto channel = mChannelList; channel; channel = channel->next)
+void
+RenderTarget::present()
+{
+	if (mPacket)
 	{
-		// skip empty channels
-		if (!channel->texture || channel->idxBuffer.empty())
-		{
-			continue;
-		}
-
-		// dont bind against the same texture
-		if (currentTexture != channel->texture)
-		{
-			currentTexture = channel->texture;
-			Texture::bind(channel->texture, textureUnit);
-		}
+		mPacket->mIsPresented = true;
+		return;
+	}
 
-		// draw
-		glCheck(glDrawElementsBaseVertex(
-				GL_TRIANGLES,
-				channel->idxBuffer.size(),
-				GL_UNSIGNED_SHORT,
-				reinterpret_cast<GLvoid*>(channel->idxOffset),
-				channel->vtxOffset));
+	if (!mBackbuffer)
+	{
+		return;
 	}
 
-	glCheck(glDisableVertexAttribArray(2));
-	glCheck(glDisableVertexAttribArray(1));
-	glCheck(glDisableVertexAttribArray(0));
+	glCheck(glBindFramebuffer(GL_READ_FRAMEBUFFER, mBackbuffer->mFramebuffer));
+	glCheck(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0));
+	glCheck(glBlitFramebuffer(
+			0, 0, mWindowSize.x, mWindowSize.y,
+			0, 0, mWindowSize.x, mWindowSize.y,
+			GL_COLOR_BUFFER_BIT,
+			GL_NEAREST));
+	RenderTexture::bind(mRenderTexture ? mRenderTexture : mBackbuffer);
+}
 
-	glCheck(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
-	glCheck(glBindBuffer(GL_ARRAY_BUFFER, 0));
+void
+RenderTarget::setFramesInFlight(unsigned depth)
+{
+	mFrameSync.setDepth(depth);
+}
 
-	Shader::bind(nullptr);
+void
+RenderTarget::setProfiling(bool enabled)
+{
+	mProfiler.setEnabled(enabled);
+}
 
-	glCheck(glBindVertexArray(0));
+void
+RenderTarget::setProfileLabel(const char *label)
+{
+	mProfileLabel = label;
+	if (mPacket)
+	{
+		mPacket->push(FramePacket::SetProfileLabel{ label });
+	}
 }
 
-RenderTarget::DrawChannel *
-RenderTarget::newChannel(const Texture *texture, unsigned vtxOffset)
+const GpuStats&
+RenderTarget::getGpuStats() const
 {
-	DrawChannel *channel;
-	if (mFreeChannels)
+	return mProfiler.getStats();
+}
+
+void
+RenderTarget::setVertexFormat(VertexFormat format)
+{
+	// the batch is written in its format as it's built
+	if (!mPacket && mIsBatching && format != mVertexFormat)
 	{
-		channel = mFreeChannels;
-		channel->idxBuffer.clear();
-		mFreeChannels = channel->next;
+		draw();
 	}
-	else
+	mVertexFormat = format;
+	if (mPacket)
 	{
-		channel = new DrawChannel();
+		mPacket->push(FramePacket::SetVertexFormat{ format });
 	}
+}
 
-	// channel initialization
-	channel->texture = texture;
-	channel->vtxOffset = vtxOffset;
-	channel->idxOffset = 0;
-	channel->next = nullptr;
-
-	// update the channel list
-	*mChannelTail = channel;
-	mChannelTail = &channel->next;
-
-	return channel;
+void
+RenderTarget::setDepthSorting(bool enabled)
+{
+	mIsDepthSorted = enabled;
+	if (mPacket)
+	{
+		mPacket->push(FramePacket::SetDepthSorting{ enabled });
+	}
 }
 
 void
-RenderTarget::setTexture(const Texture *texture)
+RenderTarget::setQuadExpansion(QuadExpansion expansion)
 {
-	// switch to batching state if needed
-	if (!mIsBatching)
+	mQuadExpansion = expansion;
+	if (mPacket)
 	{
-		mIsBatching = true;
-		beginBatch();
+		mPacket->push(FramePacket::SetQuadExpansion{ expansion });
 	}
+}
 
-	// the null texture means a white texture;
-	if (!texture)
+void
+RenderTarget::setTextureUnits(unsigned count)
+{
+	mTextureUnits = std::clamp(count, 1u, MaxTextureUnits);
+	if (mPacket)
 	{
-		texture = &mWhiteTexture;
+		mPacket->push(FramePacket::SetTextureUnits{ mTextureUnits });
 	}
+}
 
-	// return early if the texture is the same
-	if (mCurrent && mCurrent->texture == texture)
+void
+RenderTarget::addLayer()
+{
+	if (mPacket)
 	{
+		mPacket->getList().addLayer();
 		return;
 	}
 
-	// look for a channel with the same texture
-	if (auto it = mChannelMap.find(texture); it != mChannelMap.end())
+	// NOTE: the layer is part of the sort key, the channels of
+	// the previous layers can't be reused anymore.
+	nextGeneration();
+	if (mLayer < MaxLayer)
 	{
-		// channel found
-		mCurrent = it->second;
+		mLayer++;
 	}
-	else
+	if (mIsBatching && mCurrent)
 	{
-		// or add a new one
-		mCurrent = newChannel(texture, mVertices.size());
-		mChannelMap[texture] = mCurrent;
+		selectChannel(mCurrent->texture, getPipeline(mCurrent->key));
 	}
 }
 
-std::uint16_t
-RenderTarget::getPrimIndex(unsigned idxCount, unsigned vtxCount)
+void
+RenderTarget::setBlendMode(BlendMode mode)
 {
-	// ensure we have a current channel and the rendertarget is in
-	// batching state.
-	if (!mIsBatching)
+	mBlendMode = mode;
+	if (mPacket)
 	{
-		mIsBatching = true;
-		beginBatch();
-		mCurrent = newChannel(&mWhiteTexture, 0);
+		mPacket->setBlendMode(mode);
+		return;
 	}
-
-	// ensure we have enough space for the indices
-	unsigned index = mVertices.size() - mCurrent->vtxOffset;
-	if (index + vtxCount > UINT16_MAX)
+	if (mIsBatching && mCurrent)
 	{
-		mCurrent = newChannel(mCurrent->texture, mVertices.size());
-		mChannelMap[mCurrent->texture] = mCurrent;
-		index = 0;
+		selectChannel(mCurrent->texture, getPipeline(mCurrent->key));
 	}
+}
 
-	// reserve the space for the vertices and the indices
-	mVertices.reserve(mVertices.size() + vtxCount);
-	mCurrent->idxBuffer.reserve(mCurrent->idxBuffer.size() + idxCount);
+void
+RenderTarget::nextGeneration()
+{
+	// the slots stamped with an old generation are empty
+	if (++mGeneration == 0)
+	{
+		for (auto &slot : mTextureSlots)
+		{
+			slot.generation = 0;
+		}
+		mGeneration = 1;
+	}
+}
 
-	return index;
+void
+RenderTarget::beginBatch()
+{
+	if (mVertexStream.isOpen())
+	{
+		mVertexStream.end();
+	}
+	mVertexCount = 0;
+	mPendingVertices.clear();
+	mIndices.clear();
+	nextGeneration();
+	mBatchSerial++;
+	mTextureCount = 0;
+	mGroupTextures.clear();
+	mLayer = 0;
+	*mChannelTail = mFreeChannels;
+	mFreeChannels = mChannelList;
+	mChannelList = mCurrent = nullptr;
+	mChannelTail = &mChannelList;
 }
 
-Vertex*
-RenderTarget::getVertexArray(unsigned vtxCount)
+void
+RenderTarget::sortChannels()
 {
-	auto size = mVertices.size();
-	mVertices.resize(size + vtxCount);
-	return &mVertices[size];
+	mSortedChannels.clear();
+	for (auto channel = mChannelList; channel; channel = channel->next)
+	{
+		mSortedChannels.push_back(channel);
+	}
+	if (mSortedChannels.size() < 2)
+	{
+		return;
+	}
+
+	// LSD radix sort on the key bytes, the sort is stable so the
+	// channels with the same key keep their submission order.
+	const std::size_t count = mSortedChannels.size();
+	mSortScratch.resize(count);
+	for (unsigned shift = 0; shift < 64; shift += 8)
+	{
+		std::size_t offsets[257] = {};
+		for (auto channel : mSortedChannels)
+		{
+			offsets[((channel->key >> shift) & 0xFF) + 1]++;
+		}
+
+		// skip the pass when all the keys share the same byte
+		const unsigned first = (mSortedChannels[0]->key >> shift) & 0xFF;
+		if (offsets[first + 1] == count)
+		{
+			continue;
+		}
+
+		for (unsigned i = 1; i < 257; i++)
+		{
+			offsets[i] += offsets[i - 1];
+		}
+		for (auto channel : mSortedChannels)
+		{
+			mSortScratch[offsets[(channel->key >> shift) & 0xFF]++] = channel;
+		}
+		std::swap(mSortedChannels, mSortScratch);
+	}
+
+	// rebuild the channel list in the sorted order
+	mChannelTail = &mChannelList;
+	for (auto channel : mSortedChannels)
+	{
+		*mChannelTail = channel;
+		mChannelTail = &channel->next;
+	}
+	*mChannelTail = nullptr;
+}
+
+void
+RenderTarget::sortDepthPasses()
+{
+	// the opaque channels go first, walking the layers from the
+	// top one down, the order inside a layer is kept.
+	mSortScratch.clear();
+	for (std::size_t end = mSortedChannels.size(); end > 0;)
+	{
+		std::size_t begin = end - 1;
+		const unsigned layer = getLayer(mSortedChannels[begin]->key);
+		while (begin > 0 && getLayer(mSortedChannels[begin - 1]->key) == layer)
+		{
+			begin--;
+		}
+		for (std::size_t i = begin; i < end; i++)
+		{
+			if (getBlendMode(mSortedChannels[i]->key) == BlendMode::None)
+			{
+				mSortScratch.push_back(mSortedChannels[i]);
+			}
+		}
+		end = begin;
+	}
+	mHasOpaque = !mSortScratch.empty();
+
+	// then the translucent ones from the bottom layer up
+	for (auto channel : mSortedChannels)
+	{
+		if (getBlendMode(channel->key) != BlendMode::None)
+		{
+			mSortScratch.push_back(channel);
+		}
+	}
+	std::swap(mSortedChannels, mSortScratch);
+
+	mChannelTail = &mChannelList;
+	for (auto channel : mSortedChannels)
+	{
+		*mChannelTail = channel;
+		mChannelTail = &channel->next;
+	}
+	*mChannelTail = nullptr;
+}
+
+void
+RenderTarget::endBatch()
+{
+	sortChannels();
+	mHasOpaque = false;
+	if (mIsDepthSorted)
+	{
+		sortDepthPasses();
+	}
+
+	// promote the batch to 32-bit indices only if a channel
+	// cannot be addressed with 16-bit ones.
+	unsigned maxVertices = 0;
+	for (auto channel = mChannelList; channel; channel = channel->next)
+	{
+		maxVertices = std::max(maxVertices, channel->vtxCount);
+	}
+	mIndexSize = maxVertices > UINT16_MAX
+		? sizeof(std::uint32_t)
+		: sizeof(std::uint16_t);
+
+	// the indices are already in a single stream, the channels
+	// keep their ranges in it.
+	mIndexCount = mIndices.size();
+	mQuadCount = 0;
+	mQuadVertexCount = 0;
+	for (auto channel = mChannelList; channel; channel = channel->next)
+	{
+		channel->quadOffset = mQuadCount;
+		mQuadCount += channel->quads.size();
+		channel->quadVtxOffset = mQuadVertexCount;
+		mQuadVertexCount += channel->quadVertices.size();
+	}
+}
+
+template <typename T>
+void
+RenderTarget::writeTextured(std::vector<T> DrawChannel::*buffer, T *dst) const
+{
+	for (auto channel = mChannelList; channel; channel = channel->next)
+	{
+		const unsigned unit = channel->unit;
+		dst = std::transform(
+			(channel->*buffer).begin(), (channel->*buffer).end(), dst,
+			[unit](T element) {
+				element.texture = unit;
+				return element;
+			});
+	}
+}
+
+void
+RenderTarget::writeCompact(std::vector<Vertex> DrawChannel::*buffer,
+			   CompactVertex *dst) const
+{
+	for (auto channel = mChannelList; channel; channel = channel->next)
+	{
+		const auto &data = channel->*buffer;
+		dst = std::transform(data.begin(), data.end(), dst, compress);
+	}
+}
+
+void
+RenderTarget::draw()
+{
+	if (mPacket)
+	{
+		mPacket->push(FramePacket::Draw{});
+		return;
+	}
+
+	// the vertices of a batch are in the stream only until it's
+	// drawn, a batch is drawn once.
+	if (!mIsBatching)
+	{
+		return;
+	}
+	mIsBatching = false;
+	endBatch();
+	flushPendingVertices();
+
+	// skip batches without primitives
+	if (!mIndexCount && !mQuadCount && !mQuadVertexCount)
+	{
+		if (mVertexStream.isOpen())
+		{
+			mVertexStream.end();
+		}
+		return;
+	}
+	mProfiler.begin(mProfileLabel);
+
+	// the vertices of the triangles are already in the open range
+	// of the vertex stream, the quads are added after them.
+	GLenum indexType = GL_UNSIGNED_SHORT;
+	const bool compact = mVertexFormat == VertexFormat::Compact;
+	const std::size_t vertexSize = compact ? sizeof(CompactVertex) : sizeof(Vertex);
+	if (!mVertexStream.isOpen())
+	{
+		mVertexStream.begin(vertexSize);
+	}
+
+	std::size_t quadVtxOffset = 0;
+	if (mQuadVertexCount)
+	{
+		const std::size_t size = mQuadVertexCount * vertexSize;
+		void *vertices = mVertexStream.append(size, vertexSize);
+		quadVtxOffset = mVertexStream.getRangeSize() - size;
+		if (compact)
+		{
+			writeCompact(&DrawChannel::quadVertices,
+				     static_cast<CompactVertex *>(vertices));
+		}
+		else
+		{
+			writeTextured(&DrawChannel::quadVertices,
+				      static_cast<Vertex *>(vertices));
+		}
+	}
+
+	std::size_t quadOffset = 0;
+	if (mQuadCount)
+	{
+		const std::size_t size = mQuadCount * sizeof(Quad);
+		Quad *quads = static_cast<Quad *>(mVertexStream.append(size, sizeof(float)));
+		quadOffset = mVertexStream.getRangeSize() - size;
+		writeTextured(&DrawChannel::quads, quads);
+	}
+
+	const std::size_t rangeOffset = mVertexStream.end();
+	const unsigned vtxBase = rangeOffset / vertexSize;
+	const unsigned quadVtxBase = (rangeOffset + quadVtxOffset) / vertexSize;
+	const std::size_t quadBase = rangeOffset + quadOffset;
+
+	std::size_t idxBase = 0;
+	if (mIndexCount)
+	{
+		void *indices = mIndexStream.map(mIndexCount * mIndexSize, mIndexSize);
+		if (mIndexSize == sizeof(std::uint32_t))
+		{
+			std::copy(mIndices.begin(), mIndices.end(),
+				  static_cast<std::uint32_t *>(indices));
+			indexType = GL_UNSIGNED_INT;
+		}
+		else
+		{
+			std::copy(mIndices.begin(), mIndices.end(),
+				  static_cast<std::uint16_t *>(indices));
+		}
+		idxBase = mIndexStream.unmap();
+	}
+
+	// NOTE: the pipelines are bound after mapping because the
+	// streaming buffers can be replaced when they grow.
+	const unsigned vertexBuffer = mVertexStream.getHandle();
+	if (mStreamGeneration != mVertexStream.getGeneration())
+	{
+		mStreamGeneration = mVertexStream.getGeneration();
+		mPipeline.invalidate();
+		mCompactPipeline.invalidate();
+		mQuadPipeline.invalidate();
+		mPointPipeline.invalidate();
+	}
+	Pipeline &vertexPipeline = compact ? mCompactPipeline : mPipeline;
+	const Texture *boundTextures[MaxTextureUnits] = {};
+	BlendMode currentBlend = BlendMode::Alpha;
+	unsigned currentPipeline = ~0u;
+	unsigned currentUnit = ~0u;
+	unsigned currentLayer = ~0u;
+	unsigned currentGroup = ~0u;
+
+	// the depth buffer is needed only to skip the pixels hidden
+	// by the opaque channels, the layers are local to the batch.
+	const bool depthTest = mHasOpaque;
+	mProjection = mCamera.getTransform();
+	if (depthTest)
+	{
+		glCheck(glEnable(GL_DEPTH_TEST));
+		glCheck(glDepthFunc(GL_LEQUAL));
+		glCheck(glDepthMask(GL_TRUE));
+		glCheck(glClear(GL_DEPTH_BUFFER_BIT));
+	}
+
+	const bool profiling = mProfiler.isEnabled();
+	const DrawChannel *drawn = nullptr;
+	for (auto channel = mChannelList; channel; channel = channel->next)
+	{
+		// skip empty channels
+		if (!channel->texture
+		    || (channel->idxRanges.empty()
+			&& channel->quads.empty()
+			&& channel->quadVertices.empty()))
+		{
+			continue;
+		}
+
+		// submit the pending draws only when the state changes,
+		// the textures bound to the other units are kept.
+		const auto blend = getBlendMode(channel->key);
+		const unsigned pipeline = getPipeline(channel->key);
+		const bool unitChanged = compact
+			&& pipeline != QuadPipeline
+			&& currentUnit != channel->unit;
+		const unsigned layer = getLayer(channel->key);
+		const bool layerChanged = depthTest && currentLayer != layer;
+
+		// the textures of a group are bound together when the
+		// group is entered, the draws are flushed only if one of
+		// the units holds a different texture.
+		const unsigned group = getGroup(channel->key);
+		const Texture *const *groupTextures = nullptr;
+		bool rebind = boundTextures[channel->unit]
+			&& boundTextures[channel->unit] != channel->texture;
+		if (group != currentGroup)
+		{
+			groupTextures = &mGroupTextures[group * MaxTextureUnits];
+			for (unsigned unit = 0; unit < MaxTextureUnits; ++unit)
+			{
+				rebind |= groupTextures[unit] && boundTextures[unit]
+					&& boundTextures[unit] != groupTextures[unit];
+			}
+		}
+
+		// NOTE: the profiler needs a draw for each channel to
+		// measure it.
+		if (rebind
+		    || currentBlend != blend
+		    || currentPipeline != pipeline
+		    || unitChanged
+		    || layerChanged
+		    || profiling)
+		{
+			flushDraws(currentPipeline == QuadListPipeline
+				   ? GL_UNSIGNED_SHORT
+				   : indexType);
+			flushQuads(vertexBuffer, quadBase);
+			if (drawn)
+			{
+				mProfiler.mark(drawn->texture->getSlot());
+			}
+		}
+		drawn = channel;
+
+		// the depth of the layer is set with the projection,
+		// bind the pipeline again to update it.
+		if (layerChanged)
+		{
+			currentLayer = layer;
+			mProjection = mCamera.getTransform();
+			mProjection[3][2] = getDepth(layer);
+			if (currentPipeline != QuadPipeline)
+			{
+				currentPipeline = ~0u;
+			}
+		}
+
+		// the compact vertices read the unit from the
+		// constant attribute.
+		if (unitChanged)
+		{
+			currentUnit = channel->unit;
+			glCheck(glVertexAttribI4ui(3, currentUnit, 0, 0, 0));
+		}
+
+		// dont bind against the same texture
+		if (groupTextures)
+		{
+			currentGroup = group;
+			for (unsigned unit = 0; unit < MaxTextureUnits; ++unit)
+			{
+				if (groupTextures[unit] && boundTextures[unit] != groupTextures[unit])
+				{
+					boundTextures[unit] = groupTextures[unit];
+					Texture::bind(groupTextures[unit], unit);
+				}
+			}
+		}
+		if (boundTextures[channel->unit] != channel->texture)
+		{
+			boundTextures[channel->unit] = channel->texture;
+			Texture::bind(channel->texture, channel->unit);
+		}
+
+		// change the blending only when needed
+		if (blend != currentBlend)
+		{
+			currentBlend = blend;
+			applyBlendMode(blend);
+
+			// the translucent channels don't hide the others
+			if (depthTest)
+			{
+				glCheck(glDepthMask(blend == BlendMode::None ? GL_TRUE : GL_FALSE));
+			}
+		}
+
+		// draw
+		if (pipeline == QuadPipeline)
+		{
+			// the instances of the channels sharing the state
+			// are contiguous, draw them at once.
+			currentPipeline = pipeline;
+			if (!mQuadDrawCount)
+			{
+				mQuadDrawFirst = channel->quadOffset;
+			}
+			mQuadDrawCount += channel->quads.size();
+		}
+		else if (pipeline == QuadListPipeline)
+		{
+			if (currentPipeline != pipeline)
+			{
+				currentPipeline = pipeline;
+				vertexPipeline.bind(vertexBuffer);
+				vertexPipeline.setProjection(mProjection);
+				glCheck(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mQuadIndices));
+			}
+
+			// the shared indices address MaxQuadsPerDraw quads
+			// at most, move the base vertex for the others.
+			const unsigned quadCount = channel->quadVertices.size() / 4;
+			for (unsigned first = 0; first < quadCount; first += MaxQuadsPerDraw)
+			{
+				const unsigned count = std::min(quadCount - first, MaxQuadsPerDraw);
+				mDrawCounts.push_back(count * 6);
+				mDrawOffsets.push_back(nullptr);
+				mDrawBaseVertices.push_back(
+					quadVtxBase + channel->quadVtxOffset + first * 4);
+			}
+		}
+		else
+		{
+			if (currentPipeline != pipeline)
+			{
+				currentPipeline = pipeline;
+				vertexPipeline.bind(vertexBuffer);
+				vertexPipeline.setProjection(mProjection);
+				mIndexStream.bind();
+			}
+			for (const auto &range : channel->idxRanges)
+			{
+				mDrawCounts.push_back(range.count);
+				mDrawOffsets.push_back(reinterpret_cast<GLvoid*>(
+					idxBase + range.first * mIndexSize));
+				mDrawBaseVertices.push_back(vtxBase + channel->vtxOffset);
+			}
+		}
+	}
+	flushDraws(currentPipeline == QuadListPipeline ? GL_UNSIGNED_SHORT : indexType);
+	flushQuads(vertexBuffer, quadBase);
+	if (drawn)
+	{
+		mProfiler.mark(drawn->texture->getSlot());
+	}
+
+	if (depthTest)
+	{
+		glCheck(glDepthMask(GL_TRUE));
+		glCheck(glDisable(GL_DEPTH_TEST));
+	}
+
+	// restore the default blending
+	if (currentBlend != BlendMode::Alpha)
+	{
+		applyBlendMode(BlendMode::Alpha);
+	}
+}
+
+void
+RenderTarget::draw(RetainedBatch &batch, const glm::mat4 &transform)
+{
+	if (mPacket)
+	{
+		mPacket->push(FramePacket::DrawRetained{ &batch, transform });
+		return;
+	}
+
+	// keep the submission order
+	if (mIsBatching)
+	{
+		draw();
+	}
+
+	if (batch.mIsDirty)
+	{
+		batch.upload();
+	}
+	mProfiler.begin(mProfileLabel);
+
+	const glm::mat4 projection = mCamera.getTransform() * transform;
+	const Texture *currentTexture = nullptr;
+	BlendMode currentBlend = BlendMode::Alpha;
+	for (const auto &command : batch.mList.mCommands)
+	{
+		const Texture *texture = command.texture
+			? command.texture
+			: &mWhiteTexture;
+		if (currentTexture != texture)
+		{
+			currentTexture = texture;
+			Texture::bind(texture, TextureUnit);
+		}
+
+		if (currentBlend != command.blend)
+		{
+			currentBlend = command.blend;
+			applyBlendMode(command.blend);
+		}
+
+		switch (command.primitive)
+		{
+		case DrawList::Primitive::Triangles:
+			mPipeline.bind(batch.mVertexBuffer);
+			mPipeline.setProjection(projection);
+			glCheck(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batch.mIndexBuffer));
+			glCheck(glDrawElementsBaseVertex(
+					GL_TRIANGLES,
+					command.idxCount,
+					GL_UNSIGNED_INT,
+					reinterpret_cast<GLvoid*>(
+						command.idxOffset * sizeof(std::uint32_t)),
+					command.vtxOffset));
+			break;
+
+		case DrawList::Primitive::QuadList:
+			mPipeline.bind(batch.mVertexBuffer);
+			mPipeline.setProjection(projection);
+			glCheck(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mQuadIndices));
+			for (unsigned first = 0; first < command.vtxCount / 4; first += MaxQuadsPerDraw)
+			{
+				const unsigned count = std::min(command.vtxCount / 4 - first,
+								MaxQuadsPerDraw);
+				glCheck(glDrawElementsBaseVertex(
+						GL_TRIANGLES,
+						count * 6,
+						GL_UNSIGNED_SHORT,
+						nullptr,
+						command.vtxOffset + first * 4));
+			}
+			break;
+
+		case DrawList::Primitive::Quads:
+			if (mQuadExpansion == QuadExpansion::Points)
+			{
+				mPointPipeline.bind(batch.mQuadBuffer);
+				mPointPipeline.setProjection(projection);
+				glCheck(glDrawArrays(GL_POINTS, command.quadOffset, command.quadCount));
+				break;
+			}
+			mQuadPipeline.bind(batch.mQuadBuffer,
+					   command.quadOffset * sizeof(Quad));
+			mQuadPipeline.setProjection(projection);
+			glCheck(glDrawArraysInstanced(
+					GL_TRIANGLE_STRIP,
+					0,
+					4,
+					command.quadCount));
+			break;
+		}
+	}
+
+	mProfiler.mark(GpuProfiler::NoTexture);
+
+	// restore the default blending
+	if (currentBlend != BlendMode::Alpha)
+	{
+		applyBlendMode(BlendMode::Alpha);
+	}
+}
+
+void
+RenderTarget::draw(ParticleSystem &particles)
+{
+	// the step is taken now, the simulation runs with the replay
+	if (mPacket)
+	{
+		mPacket->push(FramePacket::DrawParticles{ &particles, particles.takeStep() });
+		return;
+	}
+	drawParticles(particles, particles.takeStep());
+}
+
+void
+RenderTarget::drawParticles(ParticleSystem &particles, const ParticleSystem::Step &step)
+{
+	// keep the submission order
+	if (mIsBatching)
+	{
+		draw();
+	}
+
+	if (!particles.simulate(step))
+	{
+		return;
+	}
+	mProfiler.begin(mProfileLabel);
+
+	applyBlendMode(BlendMode::Add);
+	particles.draw(mCamera.getTransform());
+	applyBlendMode(BlendMode::Alpha);
+
+	mProfiler.mark(GpuProfiler::NoTexture);
+}
+
+void
+RenderTarget::draw(const RenderTexture &texture, const FloatRect &bounds)
+{
+	// NOTE: the framebuffer rows are bottom to top, flip the
+	// texture coordinates.
+	setTexture(&texture.getTexture());
+	Quad *quad = getQuadArray(1);
+	quad->pos = bounds.pos;
+	quad->size = bounds.size;
+	quad->uvPos = glm::vec2(0.f, 1.f);
+	quad->uvSize = glm::vec2(1.f, -1.f);
+	quad->color = Color::White;
+}
+
+void
+RenderTarget::setRenderTexture(RenderTexture *texture)
+{
+	if (mPacket)
+	{
+		// the pending primitives are drawn by the replay
+		mPacket->push(FramePacket::SetRenderTexture{
+			texture, texture ? texture->getSize() : mWindowSize });
+	}
+	else if (mIsBatching)
+	{
+		// the pending primitives belong to the old destination
+		draw();
+	}
+	if (mRenderTexture)
+	{
+		mRenderTexture->mIsDirty = false;
+	}
+
+	mRenderTexture = texture;
+	if (!mPacket)
+	{
+		bindRenderTexture(texture, texture ? texture->getSize() : mWindowSize);
+	}
+}
+
+void
+RenderTarget::bindRenderTexture(RenderTexture *texture, glm::ivec2 size)
+{
+	// the textures are created on the thread owning the context
+	if (texture && texture->mTextureSize != size)
+	{
+		texture->allocate(size);
+	}
+
+	mRenderTexture = texture;
+	RenderTexture::bind(texture ? texture : mBackbuffer);
+	glCheck(glViewport(0, 0, size.x, size.y));
+
+	// the damaged region applies only to the frame
+	if (mIsScissored)
+	{
+		if (texture)
+		{
+			glCheck(glDisable(GL_SCISSOR_TEST));
+		}
+		else
+		{
+			glCheck(glEnable(GL_SCISSOR_TEST));
+		}
+	}
+}
+
+void
+RenderTarget::flushDraws(unsigned indexType)
+{
+	if (mDrawCounts.size() == 1)
+	{
+		glCheck(glDrawElementsBaseVertex(
+				GL_TRIANGLES,
+				mDrawCounts[0],
+				indexType,
+				mDrawOffsets[0],
+				mDrawBaseVertices[0]));
+	}
+	else if (!mDrawCounts.empty())
+	{
+		glCheck(glMultiDrawElementsBaseVertex(
+				GL_TRIANGLES,
+				mDrawCounts.data(),
+				indexType,
+				mDrawOffsets.data(),
+				mDrawCounts.size(),
+				mDrawBaseVertices.data()));
+	}
+
+	mDrawCounts.clear();
+	mDrawOffsets.clear();
+	mDrawBaseVertices.clear();
+}
+
+void
+RenderTarget::flushQuads(unsigned vertexBuffer, std::size_t quadBase)
+{
+	if (!mQuadDrawCount)
+	{
+		return;
+	}
+
+	// NOTE: the points are vertices, the first one is selected by
+	// the draw and the layout is specified once per batch.
+	if (mQuadExpansion == QuadExpansion::Points)
+	{
+		mPointPipeline.bind(vertexBuffer, quadBase);
+		mPointPipeline.setProjection(mProjection);
+		glCheck(glDrawArrays(GL_POINTS, mQuadDrawFirst, mQuadDrawCount));
+	}
+	else
+	{
+		mQuadPipeline.bind(vertexBuffer, quadBase + mQuadDrawFirst * sizeof(Quad));
+		mQuadPipeline.setProjection(mProjection);
+		glCheck(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, mQuadDrawCount));
+	}
+	mQuadDrawCount = 0;
+}
+
+RenderTarget::DrawChannel *
+RenderTarget::newChannel(const Texture *texture, unsigned unit, std::uint64_t key,
+			 unsigned vtxOffset)
+{
+	DrawChannel *channel;
+	if (mFreeChannels)
+	{
+		channel = mFreeChannels;
+		channel->idxRanges.clear();
+		channel->quads.clear();
+		channel->quadVertices.clear();
+		mFreeChannels = channel->next;
+	}
+	else
+	{
+		channel = new DrawChannel();
+	}
+
+	// channel initialization
+	channel->key = key;
+	channel->texture = texture;
+	channel->unit = unit;
+	channel->vtxOffset = vtxOffset;
+	channel->vtxCount = 0;
+	channel->quadOffset = 0;
+	channel->quadVtxOffset = 0;
+	channel->sibling = nullptr;
+	channel->next = nullptr;
+
+	// update the channel list
+	*mChannelTail = channel;
+	mChannelTail = &channel->next;
+
+	return channel;
+}
+
+void
+RenderTarget::setTexture(const Texture *texture)
+{
+	if (mPacket)
+	{
+		mPacket->setTexture(texture);
+		return;
+	}
+
+	// switch to batching state if needed
+	if (!mIsBatching)
+	{
+		mIsBatching = true;
+		beginBatch();
+	}
+
+	// the null texture means a white texture;
+	if (!texture)
+	{
+		texture = &mWhiteTexture;
+	}
+
+	// return early if the texture is the same
+	if (mCurrent && mCurrent->texture == texture)
+	{
+		return;
+	}
+
+	selectChannel(texture, mCurrent ? getPipeline(mCurrent->key) : TrianglePipeline);
+}
+
+void
+RenderTarget::selectChannel(const Texture *texture, unsigned pipeline)
+{
+	// the table grows only when a new texture shows up
+	const unsigned slot = texture->getSlot();
+	if (slot >= mTextureSlots.size())
+	{
+		mTextureSlots.resize(slot + 1, TextureSlot{ 0, nullptr, 0, 0, 0 });
+	}
+
+	// the textures are packed in groups of mTextureUnits in
+	// order of appearance, each one bound to its own unit.
+	auto &entry = mTextureSlots[slot];
+	if (entry.batch != mBatchSerial)
+	{
+		entry.batch = mBatchSerial;
+		entry.group = mTextureCount / mTextureUnits;
+		entry.unit = mTextureCount % mTextureUnits;
+		mTextureCount++;
+
+		const std::size_t index = entry.group * MaxTextureUnits + entry.unit;
+		if (index >= mGroupTextures.size())
+		{
+			mGroupTextures.resize(index + MaxTextureUnits, nullptr);
+		}
+		mGroupTextures[index] = texture;
+	}
+
+	const std::uint64_t key = makeSortKey(mLayer, mBlendMode, pipeline, entry.group);
+	if (mCurrent && mCurrent->texture == texture && mCurrent->key == key)
+	{
+		return;
+	}
+
+	if (entry.generation != mGeneration)
+	{
+		entry.generation = mGeneration;
+		entry.channels = nullptr;
+	}
+
+	// look for a channel with the same key among the ones of
+	// the texture
+	DrawChannel *channel = entry.channels;
+	while (channel && channel->key != key)
+	{
+		channel = channel->sibling;
+	}
+
+	// or add a new one
+	if (!channel)
+	{
+		channel = newChannel(texture, entry.unit, key, mVertexCount);
+		channel->sibling = entry.channels;
+		entry.channels = channel;
+	}
+	mCurrent = channel;
+}
+
+unsigned
+RenderTarget::getPrimIndex(unsigned idxCount, unsigned vtxCount)
+{
+	if (mPacket)
+	{
+		return mPacket->getList().getPrimIndex(idxCount, vtxCount);
+	}
+
+	const unsigned index = addPrimitive(vtxCount);
+
+	// grow the indices geometrically, an exact reserve would
+	// reallocate each time.
+	if (mIndices.size() + idxCount > mIndices.capacity())
+	{
+		mIndices.reserve(std::max(mIndices.capacity() * 2,
+					  mIndices.size() + idxCount));
+	}
+
+	return index;
+}
+
+unsigned
+RenderTarget::addPrimitive(unsigned vtxCount)
+{
+	// ensure we have a current channel and the rendertarget is in
+	// batching state.
+	if (!mIsBatching)
+	{
+		mIsBatching = true;
+		beginBatch();
+		selectChannel(&mWhiteTexture, TrianglePipeline);
+	}
+	else if (getPipeline(mCurrent->key) != TrianglePipeline)
+	{
+		selectChannel(mCurrent->texture, TrianglePipeline);
+	}
+
+	// track the vertices addressed by the channel
+	unsigned index = mVertexCount - mCurrent->vtxOffset;
+	mCurrent->vtxCount = index + vtxCount;
+	return index;
+}
+
+void
+RenderTarget::addIndexRange(unsigned first, unsigned count)
+{
+	// extend the last range when the indices follow it
+	auto &ranges = mCurrent->idxRanges;
+	if (!ranges.empty() && ranges.back().first + ranges.back().count == first)
+	{
+		ranges.back().count += count;
+	}
+	else if (count)
+	{
+		ranges.push_back({ first, count });
+	}
+}
+
+Vertex*
+RenderTarget::getVertexArray(unsigned vtxCount)
+{
+	if (mPacket)
+	{
+		return mPacket->getList().getVertexArray(vtxCount);
+	}
+
+	Vertex *vertices = allocateVertices(vtxCount);
+	const unsigned unit = mCurrent->unit;
+	for (unsigned i = 0; i < vtxCount; i++)
+	{
+		vertices[i].texture = unit;
+	}
+	return vertices;
+}
+
+Vertex*
+RenderTarget::allocateVertices(unsigned vtxCount)
+{
+	// the previous compact array is converted before the stream
+	// moves on
+	flushPendingVertices();
+	mVertexCount += vtxCount;
+	if (mVertexFormat == VertexFormat::Compact)
+	{
+		mPendingVertices.resize(vtxCount);
+		return mPendingVertices.data();
+	}
+
+	// the standard vertices are written in place
+	return static_cast<Vertex *>(appendVertices(vtxCount));
+}
+
+void *
+RenderTarget::appendVertices(unsigned vtxCount)
+{
+	const std::size_t vertexSize = mVertexFormat == VertexFormat::Compact
+		? sizeof(CompactVertex)
+		: sizeof(Vertex);
+	if (!mVertexStream.isOpen())
+	{
+		mVertexStream.begin(vertexSize);
+	}
+	return mVertexStream.append(vtxCount * vertexSize, vertexSize);
+}
+
+void
+RenderTarget::flushPendingVertices()
+{
+	if (mPendingVertices.empty())
+	{
+		return;
+	}
+
+	auto vertices = static_cast<CompactVertex *>(appendVertices(mPendingVertices.size()));
+	std::transform(mPendingVertices.begin(), mPendingVertices.end(), vertices, compress);
+	mPendingVertices.clear();
+}
+
+void
+RenderTarget::updateTexture(Texture &texture, const std::uint8_t *pixels,
+			    glm::ivec2 size, const IntRect &area)
+{
+	// the rows of the area are packed together
+	const std::size_t rowSize = area.size.x * 4;
+	std::vector<std::uint8_t> rows(rowSize * area.size.y);
+	for (int y = 0; y < area.size.y; y++)
+	{
+		std::copy_n(pixels + ((area.pos.y + y) * size.x + area.pos.x) * 4,
+			    rowSize,
+			    rows.data() + y * rowSize);
+	}
+
+	if (mPacket)
+	{
+		mPacket->push(FramePacket::UpdateTexture{ &texture, size, area, std::move(rows) });
+		return;
+	}
+	uploadTexture(texture, size, area, rows.data());
+}
+
+void
+RenderTarget::uploadTexture(Texture &texture, glm::ivec2 size,
+			    const IntRect &area, const std::uint8_t *pixels)
+{
+	if (texture.getWidth() != static_cast<unsigned>(size.x)
+	    || texture.getHeight() != static_cast<unsigned>(size.y))
+	{
+		texture.create(size.x, size.y);
+	}
+	texture.update(pixels, area.pos.x, area.pos.y, area.size.x, area.size.y);
+}
+
+void
+RenderTarget::submit(const DrawList &list)
+{
+	// the list is copied, the caller can clear it
+	if (mPacket)
+	{
+		mPacket->submit(list);
+		if (!list.mCommands.empty())
+		{
+			mPacket->setTexture(list.mCommands.back().texture);
+		}
+		return;
+	}
+
+	merge(list);
+}
+
+void
+RenderTarget::merge(const DrawList &list)
+{
+	// replay the recorded commands, each one is added as a whole:
+	// the indices are rebased on the channel in one pass and the
+	// vertices are written in the stream with their unit.
+	const BlendMode blendMode = mBlendMode;
+	for (const auto &command : list.mCommands)
+	{
+		if (command.newLayer)
+		{
+			addLayer();
+		}
+		setBlendMode(command.blend);
+		setTexture(command.texture);
+
+		const Vertex *vertices = list.mVertices.data() + command.vtxOffset;
+		switch (command.primitive)
+		{
+		case DrawList::Primitive::Triangles:
+		{
+			const unsigned base = addPrimitive(command.vtxCount);
+			const auto indices = list.mIndices.begin() + command.idxOffset;
+			const unsigned first = mIndices.size();
+			if (first + command.idxCount > mIndices.capacity())
+			{
+				mIndices.reserve(std::max(mIndices.capacity() * 2,
+							  mIndices.size() + command.idxCount));
+			}
+			std::transform(indices, indices + command.idxCount,
+				       std::back_inserter(mIndices),
+				       [base](std::uint32_t index) { return base + index; });
+			addIndexRange(first, command.idxCount);
+			addVertices(vertices, vertices + command.vtxCount);
+			break;
+		}
+		case DrawList::Primitive::QuadList:
+			std::copy_n(vertices, command.vtxCount,
+				    getQuadVertexArray(command.vtxCount / 4));
+			break;
+		case DrawList::Primitive::Quads:
+			std::copy_n(list.mQuads.data() + command.quadOffset,
+				    command.quadCount,
+				    getQuadArray(command.quadCount));
+			break;
+		}
+	}
+	setBlendMode(blendMode);
+}
+
+Vertex*
+RenderTarget::getQuadVertexArray(unsigned count)
+{
+	if (mPacket)
+	{
+		return mPacket->getList().getQuadVertexArray(count);
+	}
+
+	// ensure we have a quad list channel and the rendertarget is
+	// in batching state.
+	if (!mIsBatching)
+	{
+		mIsBatching = true;
+		beginBatch();
+		selectChannel(&mWhiteTexture, QuadListPipeline);
+	}
+	else if (getPipeline(mCurrent->key) != QuadListPipeline)
+	{
+		selectChannel(mCurrent->texture, QuadListPipeline);
+	}
+
+	auto &vertices = mCurrent->quadVertices;
+	auto size = vertices.size();
+	vertices.resize(size + count * 4);
+	return &vertices[size];
+}
+
+Quad*
+RenderTarget::getQuadArray(unsigned count)
+{
+	if (mPacket)
+	{
+		return mPacket->getList().getQuadArray(count);
+	}
+
+	// ensure we have a quad channel and the rendertarget is in
+	// batching state.
+	if (!mIsBatching)
+	{
+		mIsBatching = true;
+		beginBatch();
+		selectChannel(&mWhiteTexture, QuadPipeline);
+	}
+	else if (getPipeline(mCurrent->key) != QuadPipeline)
+	{
+		selectChannel(mCurrent->texture, QuadPipeline);
+	}
+
+	auto &quads = mCurrent->quads;
+	auto size = quads.size();
+	quads.resize(size + count);
+	return &quads[size];
 }
@@ -1,15 +1,25 @@
 #pragma once
 
-#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
 #include <vector>
 
+#include "blendmode.hpp"
 #include "color.hpp"
-#include "shader.hpp"
+#include "drawlist.hpp"
+#include "framepacket.hpp"
+#include "framesync.hpp"
+#include "gpuprofiler.hpp"
+#include "particlesystem.hpp"
+#include "pipeline.hpp"
+#include "retainedbatch.hpp"
+#include "streambuffer.hpp"
 #include "texture.hpp"
 #include "vertex.hpp"
 #include "camera.hpp"
 
-class Canvas;
+class RenderTexture;
 class Window;
 
 class RenderTarget
@@ -39,6 +49,15 @@ public:
 	 */
 	const Camera& getDefaultCamera() const;
 
+	/**
+	 * Check if a world space box can be seen through the current
+	 * Camera. Use it to skip the primitives before allocating
+	 * their vertices.
+	 *
+	 * @param[in] bounds bounding box of the primitive.
+	 */
+	bool isVisible(const FloatRect &bounds) const;
+
 	/**
 	 * Clear the target with the given @color.
 	 * @param[in] color
@@ -46,15 +65,174 @@ public:
 	void clear(Color = Color::Black);
 
 	/**
-	 * Force a new draw command.
+	 * Start a new layer: the primitives added from now on are
+	 * drawn on top of the previous ones.
 	 */
 	void addLayer();
 
+	/**
+	 * Set how many textures a single draw can sample from, the
+	 * count is clamped between 1 and 8. With 1 each texture change
+	 * splits the batch, with more the textures are bound together
+	 * and each vertex selects its own.
+	 *
+	 * @param[in] count number of texture units.
+	 */
+	void setTextureUnits(unsigned count);
+
+	/**
+	 * Mark a world space rectangle, seen through the current
+	 * Camera, to be drawn again by the next frame.
+	 *
+	 * @param[in] bounds the damaged rectangle.
+	 */
+	void invalidate(const FloatRect &bounds);
+
+	/**
+	 * Mark the whole target to be drawn again by the next frame.
+	 */
+	void invalidate();
+
+	/**
+	 * Start a frame: the drawing is clipped to the union of the
+	 * damaged rectangles. It needs a backbuffer (see use()) to
+	 * keep the pixels outside of it.
+	 *
+	 * @retval true the frame must be drawn.
+	 * @retval false nothing changed, skip the frame.
+	 */
+	bool beginFrame();
+
+	/**
+	 * Mark the end of a frame, call it once per frame after the
+	 * last draw. It waits for the GPU when too many frames are in
+	 * flight.
+	 */
+	void endFrame();
+
+	/**
+	 * Copy the backbuffer to the window framebuffer, before
+	 * Window::display().
+	 */
+	void present();
+
+	/**
+	 * Set how many frames the GPU can lag behind, between 1 and 3.
+	 *
+	 * @param[in] depth frames in flight.
+	 */
+	void setFramesInFlight(unsigned depth);
+
+	/**
+	 * Measure the GPU time of each draw() with timer queries.
+	 * Each channel is drawn on its own while profiling, to
+	 * attribute the time to its texture.
+	 *
+	 * @param[in] enabled true to start profiling.
+	 */
+	void setProfiling(bool enabled);
+
+	/**
+	 * Attribute the GPU time of the next draws to @label, it must
+	 * point to a string with static storage.
+	 *
+	 * @param[in] label name of the caller, null for none.
+	 */
+	void setProfileLabel(const char *label);
+
+	/**
+	 * Get the GPU time of the last frame the results are
+	 * available for, usually a few frames ago.
+	 */
+	const GpuStats& getGpuStats() const;
+
+	/**
+	 * Set the format of the vertices sent to the GPU for the next
+	 * batch, a pending batch in the other format is drawn before.
+	 * The compact format halves the upload of the
+	 * triangles and of the quad lists but it can't batch
+	 * different textures together, see CompactVertex for its
+	 * limits. The instanced quads are not affected.
+	 *
+	 * @param[in] format vertex format of the batch.
+	 */
+	void setVertexFormat(VertexFormat format);
+
+	/**
+	 * Draw the opaque primitives, the ones using BlendMode::None,
+	 * front to back with a depth test and then the translucent ones
+	 * back to front over them. The depth is given by the layer,
+	 * see addLayer(), so the pixels hidden by an opaque primitive
+	 * of an upper layer are not shaded. The destination needs a
+	 * depth buffer, the layers of a batch don't hide the previous
+	 * batches.
+	 *
+	 * @param[in] enabled true to use the depth buffer.
+	 */
+	void setDepthSorting(bool enabled);
+
+	/**
+	 * Set how the quads of getQuadArray() are drawn. With points
+	 * each quad is a single vertex expanded by a geometry shader,
+	 * without instancing. The quads of the retained batches are
+	 * drawn the same way.
+	 *
+	 * @param[in] expansion expansion of the next quads drawn.
+	 */
+	void setQuadExpansion(QuadExpansion expansion);
+
+	/**
+	 * Set the blending mode for the next primitive.
+	 *
+	 * @param[in] mode blending mode.
+	 */
+	void setBlendMode(BlendMode mode);
+
 	/**
 	 * Send the blob of vertices to the GPU.
 	 */
 	void draw();
 
+	/**
+	 * Draw a retained @batch, uploading it first if it has been
+	 * edited. The current batch is drawn before it.
+	 *
+	 * The batch is drawn in recording order with the standard
+	 * vertex format, setVertexFormat() and setDepthSorting() don't
+	 * apply to it.
+	 *
+	 * @param[in] batch the retained geometry.
+	 * @param[in] transform transform applied to the geometry.
+	 */
+	void draw(RetainedBatch &batch, const glm::mat4 &transform = glm::mat4(1.f));
+
+	/**
+	 * Run the pending simulation of the @particles and draw them
+	 * with additive blending. The current batch is drawn before.
+	 *
+	 * @param[in] particles the particle system.
+	 */
+	void draw(ParticleSystem &particles);
+
+	/**
+	 * Add the content of a RenderTexture to the batch as a single
+	 * quad covering the world space @bounds.
+	 *
+	 * @param[in] texture the texture to composite.
+	 * @param[in] bounds world space rectangle covered by the quad.
+	 */
+	void draw(const RenderTexture &texture, const FloatRect &bounds);
+
+	/**
+	 * Draw into @texture instead of the window, or into the window
+	 * (or the backbuffer given to use()) again if null. The current batch is drawn first and the
+	 * RenderTexture left is marked as up to date. The Camera is
+	 * not changed.
+	 *
+	 * @param[in] texture the destination of the next draws.
+	 */
+	void setRenderTexture(RenderTexture *texture);
+
 	/**
 	 * Set the texture for the next primitive.
 	 */
@@ -63,12 +241,16 @@ public:
 	/**
 	 * Get the base index for the primitive and reserve space in
 	 * the vertex and index buffers.
+	 *
+	 * NOTE: the batch is drawn with 16-bit indices and it's
+	 * promoted to 32-bit indices when a channel addresses more
+	 * than UINT16_MAX vertices.
 	 */
-	std::uint16_t getPrimIndex(unsigned idxCount, unsigned vtxCount);
+	unsigned getPrimIndex(unsigned idxCount, unsigned vtxCount);
 
 	/**
-	 * Add a sequence of indices to the DrawChannel, with an
-	 * @offset applied to them. The offset is obtained by using
+	 * Add a sequence of indices to the batch index stream, with
+	 * an @offset applied to them. The offset is obtained by using
 	 * getPrimIndex().
 	 *
 	 * @param[in] offset offset to add to each index.
@@ -76,7 +258,7 @@ public:
 	 * @param[in] end end iterator of the range.
 	 */
 	template <typename Iterator>
-	void addIndices(std::uint16_t offset, Iterator start, Iterator end);
+	void addIndices(unsigned offset, Iterator start, Iterator end);
 
 	/**
 	 * Add a sequence of vertices to the DrawChannel.
@@ -87,41 +269,202 @@ public:
 	template <typename Iterator>
 	void addVertices(Iterator start, Iterator end);
 
+	/**
+	 * Get an array of @vtxCount vertices for the primitive. The
+	 * vertices are written straight into the vertex stream with
+	 * their texture field already set: write the other fields and
+	 * don't read them back. The pointer is valid until the next
+	 * call adding vertices.
+	 */
 	Vertex* getVertexArray(unsigned vtxCount);
 
+	/**
+	 * Get the vertices of @count quads drawn with the shared quad
+	 * index buffer and the current texture. The four corners of
+	 * each quad are expected in the order top-left, bottom-left,
+	 * top-right, bottom-right. The pointer is valid until the
+	 * next call.
+	 *
+	 * @param[in] count number of quads.
+	 */
+	Vertex* getQuadVertexArray(unsigned count);
+
+	/**
+	 * Get an array of @count quads drawn with instancing and the
+	 * current texture. The pointer is valid until the next call.
+	 *
+	 * @param[in] count number of quads.
+	 */
+	Quad* getQuadArray(unsigned count);
+
+	/**
+	 * Copy the @area of an RGBA image of @size pixels into the
+	 * @texture, created first with @size if it has another size.
+	 * While recording, the pixels of the area are copied into the
+	 * packet and uploaded by the thread owning the context.
+	 *
+	 * @param[in] texture the texture to update.
+	 * @param[in] pixels pixels of the whole image.
+	 * @param[in] size size of the image.
+	 * @param[in] area region of the image to upload.
+	 */
+	void updateTexture(Texture &texture, const std::uint8_t *pixels,
+			   glm::ivec2 size, const IntRect &area);
+
+	/**
+	 * Merge the primitives recorded in @list into the current
+	 * batch. It must be called from the thread owning the context.
+	 *
+	 * @param[in] list the recorded primitives.
+	 */
+	void submit(const DrawList &list);
+
 	/**
 	 * Use the @window as a drawing backend.
 	 *
 	 * @param[in] window Window to use as a drawing backend.
+	 * @param[in] backbuffer draw into it instead of the window
+	 *            framebuffer, it must be as large as the window.
 	 */
-	void use(const Window &window);
+	void use(const Window &window, RenderTexture *backbuffer = nullptr);
+
+	/**
+	 * Record the frames into FramePackets instead of drawing them,
+	 * the @window gives the size of the target. No context is
+	 * needed: a RenderThread gives the packets to record into and
+	 * replays them with another RenderTarget, which keeps the
+	 * frame fences and the GPU profiler.
+	 *
+	 * @param[in] window Window the frames are drawn to.
+	 */
+	void record(const Window &window);
+
+	/**
+	 * Draw a frame recorded by another RenderTarget, from
+	 * beginFrame() to endFrame(). It must be called from the
+	 * thread owning the context.
+	 *
+	 * @param[in] packet the recorded frame.
+	 *
+	 * @retval true the frame was drawn and presented.
+	 * @retval false nothing to show.
+	 */
+	bool replay(const FramePacket &packet);
 
 protected:
 	void initialize();
 
 private:
+	friend class RenderThread;
+
+	struct IndexRange
+	{
+		unsigned first;
+		unsigned count;
+	};
+
 	struct DrawChannel
 	{
+		std::uint64_t key;
 		const Texture *texture;
+		unsigned unit;
 		unsigned vtxOffset;
-		unsigned idxOffset;
-		std::vector<std::uint16_t> idxBuffer;
+		unsigned vtxCount;
+		std::vector<IndexRange> idxRanges;
+		unsigned quadOffset;
+		std::vector<Quad> quads;
+		unsigned quadVtxOffset;
+		std::vector<Vertex> quadVertices;
+		DrawChannel *sibling;
 		DrawChannel *next;
 	};
 
+	struct TextureSlot
+	{
+		unsigned generation;
+		DrawChannel *channels;
+		unsigned batch;
+		unsigned group;
+		unsigned unit;
+	};
+
 private:
-	DrawChannel *newChannel(const Texture *texture, unsigned vtxOffset);
+	DrawChannel *newChannel(const Texture *texture, unsigned unit,
+				std::uint64_t key, unsigned vtxOffset);
+	void selectChannel(const Texture *texture, unsigned pipeline);
+	void sortChannels();
+	void sortDepthPasses();
+	void nextGeneration();
 	void beginBatch();
 	void endBatch();
 
+	bool clipDamage(glm::ivec2 &low, glm::ivec2 &high) const;
+	void bindRenderTexture(RenderTexture *texture, glm::ivec2 size);
+	void uploadTexture(Texture &texture, glm::ivec2 size,
+			   const IntRect &area, const std::uint8_t *pixels);
+
+	unsigned addPrimitive(unsigned vtxCount);
+	void addIndexRange(unsigned first, unsigned count);
+	void merge(const DrawList &list);
+	Vertex *allocateVertices(unsigned vtxCount);
+	void *appendVertices(unsigned vtxCount);
+	void flushPendingVertices();
+	void flushDraws(unsigned indexType);
+	void flushQuads(unsigned vertexBuffer, std::size_t quadBase);
+	void drawParticles(ParticleSystem &particles, const ParticleSystem::Step &step);
+
+	template <typename T>
+	void writeTextured(std::vector<T> DrawChannel::*buffer, T *dst) const;
+
+	void writeCompact(std::vector<Vertex> DrawChannel::*buffer,
+			  CompactVertex *dst) const;
+
 private:
-	Camera mDefaultCamera;
-	Camera mCamera;
+	Camera    mDefaultCamera;
+	Camera    mCamera;
+	FloatRect mCameraBounds;
+
+	glm::ivec2     mWindowSize;
+	RenderTexture *mBackbuffer;
+	RenderTexture *mRenderTexture;
+
+	FramePacket *mPacket;
+
+	FrameSync    mFrameSync;
+	GpuProfiler  mProfiler;
+	const char  *mProfileLabel;
 
-	std::vector<Vertex>        mVertices;
-	std::vector<std::uint16_t> mIndices;
-	std::unordered_map<const Texture *, DrawChannel*> mChannelMap;
+	FloatRect    mDamage;
+	bool         mIsDamaged;
+	bool         mIsFullyDamaged;
+	bool         mIsScissored;
 
+	unsigned            mVertexCount;
+	std::vector<Vertex> mPendingVertices;
+	std::vector<std::uint32_t> mIndices;
+	unsigned            mIndexCount;
+	unsigned            mIndexSize;
+	unsigned            mQuadCount;
+	unsigned            mQuadVertexCount;
+	std::vector<TextureSlot>  mTextureSlots;
+	unsigned                  mGeneration;
+	unsigned                  mBatchSerial;
+	unsigned                  mTextureCount;
+	unsigned                  mTextureUnits;
+	std::vector<const Texture*> mGroupTextures;
+	std::vector<DrawChannel*> mSortedChannels;
+	std::vector<DrawChannel*> mSortScratch;
+	std::vector<int>          mDrawCounts;
+	std::vector<void*>        mDrawOffsets;
+	std::vector<int>          mDrawBaseVertices;
+
+	unsigned      mLayer;
+	BlendMode     mBlendMode;
+	VertexFormat  mVertexFormat;
+	QuadExpansion mQuadExpansion;
+	bool          mIsDepthSorted;
+	bool          mHasOpaque;
+	glm::mat4     mProjection;
 	bool          mIsBatching;
 	DrawChannel  *mChannelList;
 	DrawChannel **mChannelTail;
@@ -129,25 +472,50 @@ private:
 	DrawChannel  *mFreeChannels;
 
 	Texture       mWhiteTexture;
-	Shader        mShader;
-	unsigned      mVBO;
-	unsigned      mEBO;
-	unsigned      mVAO;
+	Pipeline      mPipeline;
+	Pipeline      mCompactPipeline;
+	Pipeline      mQuadPipeline;
+	Pipeline      mPointPipeline;
+	StreamBuffer  mVertexStream;
+	StreamBuffer  mIndexStream;
+	unsigned      mStreamGeneration;
+	unsigned      mQuadIndices;
+	unsigned      mQuadDrawFirst;
+	unsigned      mQuadDrawCount;
 };
 
 template <typename Iterator>
 void
-RenderTarget::addIndices(std::uint16_t offset, Iterator start, Iterator end)
+RenderTarget::addIndices(unsigned offset, Iterator start, Iterator end)
 {
+	if (mPacket)
+	{
+		mPacket->getList().addIndices(offset, start, end);
+		return;
+	}
+
+	const unsigned first = mIndices.size();
 	for (; start != end; ++start)
 	{
-		mCurrent->idxBuffer.push_back(offset + *start);
+		mIndices.push_back(offset + *start);
 	}
+	addIndexRange(first, mIndices.size() - first);
 }
 
 template <typename Iterator>
 void
 RenderTarget::addVertices(Iterator start, Iterator end)
 {
-	mVertices.insert(mVertices.end(), start, end);
+	if (mPacket)
+	{
+		std::copy(start, end, mPacket->getList().getVertexArray(std::distance(start, end)));
+		return;
+	}
+
+	const unsigned unit = mCurrent->unit;
+	std::transform(start, end, allocateVertices(std::distance(start, end)),
+		       [unit](Vertex vertex) {
+			       vertex.texture = unit;
+			       return vertex;
+		       });
 }
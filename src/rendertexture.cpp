@@ -0,0 +1,135 @@
+#include <iostream>
+
+#include <GL/glew.h>
+
+#include "glcheck.hpp"
+#include "rendertexture.hpp"
+
+RenderTexture::RenderTexture()
+	: mFramebuffer(0)
+	, mDepthBuffer(0)
+	, mSize(0, 0)
+	, mTextureSize(0, 0)
+	, mIsDirty(true)
+{
+}
+
+RenderTexture::~RenderTexture()
+{
+	if (mFramebuffer)
+	{
+		glCheck(glDeleteFramebuffers(1, &mFramebuffer));
+	}
+	if (mDepthBuffer)
+	{
+		glCheck(glDeleteRenderbuffers(1, &mDepthBuffer));
+	}
+}
+
+bool
+RenderTexture::create(unsigned width, unsigned height)
+{
+	mIsDirty = true;
+	if (!allocate(glm::ivec2(width, height)))
+	{
+		return false;
+	}
+
+	mSize = glm::ivec2(width, height);
+	return true;
+}
+
+void
+RenderTexture::setSize(unsigned width, unsigned height)
+{
+	mIsDirty = true;
+	mSize = glm::ivec2(width, height);
+}
+
+// NOTE: the texture size is owned by the thread of the context, the
+// size seen by the owner can be already changed.
+bool
+RenderTexture::allocate(glm::ivec2 size)
+{
+	if (!mTexture.create(size.x, size.y))
+	{
+		return false;
+	}
+
+	if (!mFramebuffer)
+	{
+		glCheck(glGenFramebuffers(1, &mFramebuffer));
+		if (!mFramebuffer)
+		{
+			std::cerr << "Failed to create the framebuffer." << std::endl;
+			return false;
+		}
+	}
+
+	if (!mDepthBuffer)
+	{
+		glCheck(glGenRenderbuffers(1, &mDepthBuffer));
+		if (!mDepthBuffer)
+		{
+			std::cerr << "Failed to create the depth buffer." << std::endl;
+			return false;
+		}
+	}
+	glCheck(glBindRenderbuffer(GL_RENDERBUFFER, mDepthBuffer));
+	glCheck(glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.x, size.y));
+	glCheck(glBindRenderbuffer(GL_RENDERBUFFER, 0));
+
+	GLint oldDrawFB;
+	glCheck(glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &oldDrawFB));
+	glCheck(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, mFramebuffer));
+	glCheck(glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER,
+				       GL_COLOR_ATTACHMENT0,
+				       GL_TEXTURE_2D,
+				       mTexture.mTexture,
+				       0));
+	glCheck(glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER,
+					  GL_DEPTH_ATTACHMENT,
+					  GL_RENDERBUFFER,
+					  mDepthBuffer));
+	GLenum status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+	glCheck(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, oldDrawFB));
+	if (status != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Failed to create the framebuffer, status "
+			  << status << std::endl;
+		return false;
+	}
+
+	mTextureSize = size;
+	return true;
+}
+
+glm::ivec2
+RenderTexture::getSize() const
+{
+	return mSize;
+}
+
+const Texture&
+RenderTexture::getTexture() const
+{
+	return mTexture;
+}
+
+bool
+RenderTexture::isDirty() const
+{
+	return mIsDirty;
+}
+
+void
+RenderTexture::invalidate()
+{
+	mIsDirty = true;
+}
+
+void
+RenderTexture::bind(const RenderTexture *texture) noexcept
+{
+	glCheck(glBindFramebuffer(GL_FRAMEBUFFER, texture ? texture->mFramebuffer : 0));
+}
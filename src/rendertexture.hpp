@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "texture.hpp"
+
+/**
+ * A texture backed by a framebuffer object, the RenderTarget can
+ * draw into it and then composite it as a single textured quad.
+ *
+ * The content is kept until the RenderTexture is invalidated: a
+ * static layer is drawn once and reused for the next frames. The
+ * framebuffer has a depth buffer for RenderTarget::setDepthSorting().
+ */
+class RenderTexture
+{
+public:
+	RenderTexture();
+	~RenderTexture();
+
+	RenderTexture(const RenderTexture &) = delete;
+	RenderTexture(RenderTexture &&) noexcept = delete;
+	RenderTexture& operator=(const RenderTexture &) = delete;
+	RenderTexture& operator=(RenderTexture &&) noexcept = delete;
+
+	/**
+	 * Create the texture and the framebuffer, the content is
+	 * invalidated.
+	 *
+	 * @param[in] width width in pixels.
+	 * @param[in] height height in pixels.
+	 */
+	bool create(unsigned width, unsigned height);
+
+	/**
+	 * Set the size without a context, the texture is created by
+	 * the RenderTarget the first time it draws into it. The
+	 * content is invalidated.
+	 *
+	 * @param[in] width width in pixels.
+	 * @param[in] height height in pixels.
+	 */
+	void setSize(unsigned width, unsigned height);
+
+	/**
+	 * Get the size in pixels, zero if not created or sized.
+	 */
+	glm::ivec2 getSize() const;
+
+	/**
+	 * Get the texture the content is rendered to. The rows are
+	 * stored bottom to top as in the OpenGL framebuffers.
+	 */
+	const Texture& getTexture() const;
+
+	/**
+	 * Check if the content must be drawn again.
+	 */
+	bool isDirty() const;
+
+	/**
+	 * Mark the content to be drawn again.
+	 */
+	void invalidate();
+
+	/**
+	 * Bind the framebuffer of the @texture as the drawing
+	 * destination, the default framebuffer if null.
+	 */
+	static void bind(const RenderTexture *texture) noexcept;
+
+private:
+	bool allocate(glm::ivec2 size);
+
+private:
+	Texture     mTexture;
+	unsigned    mFramebuffer;
+	unsigned    mDepthBuffer;
+	glm::ivec2  mSize;
+	glm::ivec2  mTextureSize;
+	bool        mIsDirty;
+
+	friend class RenderTarget;
+};
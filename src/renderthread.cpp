@@ -0,0 +1,141 @@
+#include "renderthread.hpp"
+#include "window.hpp"
+
+namespace
+{
+// frames recorded while the previous one is drawn
+const unsigned PacketCount = 2;
+}
+
+RenderThread::RenderThread()
+	: mWindow(nullptr)
+	, mRecorder(nullptr)
+	, mPublished(0)
+	, mDrawn(0)
+	, mIsRunning(false)
+{
+}
+
+RenderThread::~RenderThread()
+{
+	stop();
+}
+
+RenderTarget&
+RenderThread::getTarget()
+{
+	return mTarget;
+}
+
+void
+RenderThread::start(Window &window, RenderTarget &recorder)
+{
+	mWindow = &window;
+	mRecorder = &recorder;
+	mRecorder->record(window);
+	mPublished = mDrawn = 0;
+	mIsRunning = true;
+
+	// a context is current on one thread at a time
+	Window::setContext(nullptr);
+	mThread = std::thread(&RenderThread::run, this);
+}
+
+void
+RenderThread::stop()
+{
+	if (!mThread.joinable())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mIsRunning = false;
+	}
+	mCondition.notify_all();
+	mThread.join();
+	Window::setContext(mWindow);
+}
+
+bool
+RenderThread::beginFrame()
+{
+	// the packet is free once the frame recorded two frames ago
+	// is drawn.
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mCondition.wait(lock, [this]() {
+			return mPublished - mDrawn < PacketCount;
+		});
+	}
+
+	FramePacket &packet = mPackets[mPublished % PacketCount];
+	packet.clear();
+	mRecorder->mPacket = &packet;
+	if (!mRecorder->beginFrame())
+	{
+		mRecorder->mPacket = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void
+RenderThread::endFrame()
+{
+	mRecorder->endFrame();
+	mRecorder->present();
+	mRecorder->mPacket = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mPublished++;
+	}
+	mCondition.notify_all();
+}
+
+void
+RenderThread::wait()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mCondition.wait(lock, [this]() {
+		return mDrawn == mPublished;
+	});
+}
+
+void
+RenderThread::run()
+{
+	Window::setContext(mWindow);
+
+	std::unique_lock<std::mutex> lock(mMutex);
+	for (;;)
+	{
+		mCondition.wait(lock, [this]() {
+			return mDrawn != mPublished || !mIsRunning;
+		});
+
+		// draw the pending frames before stopping
+		if (mDrawn == mPublished)
+		{
+			break;
+		}
+
+		// NOTE: the packet is not changed until it's drawn, it
+		// can be read without the lock.
+		const FramePacket &packet = mPackets[mDrawn % PacketCount];
+		lock.unlock();
+		if (mTarget.replay(packet))
+		{
+			mWindow->display();
+		}
+		lock.lock();
+
+		mDrawn++;
+		mCondition.notify_all();
+	}
+	lock.unlock();
+
+	Window::setContext(nullptr);
+}
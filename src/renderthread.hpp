@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "framepacket.hpp"
+#include "rendertarget.hpp"
+
+class Window;
+
+/**
+ * Draw the frames on a thread owning the OpenGL context.
+ *
+ * The main thread records a frame into a FramePacket through a
+ * RenderTarget in recording mode, then hands it to the render
+ * thread and goes on with the next update while the packet is
+ * replayed, presented and displayed. The packets are double
+ * buffered: the main thread waits only when it's two frames ahead.
+ *
+ * NOTE: the OpenGL resources (textures, retained batches, the
+ * backbuffer) must be created before start(), a RetainedBatch can
+ * be edited only after wait(). The glyphs of a Font are uploaded
+ * through the packet, see RenderTarget::updateTexture().
+ */
+class RenderThread
+{
+public:
+	RenderThread();
+	~RenderThread();
+
+	RenderThread(const RenderThread &) = delete;
+	RenderThread(RenderThread &&) noexcept = delete;
+	RenderThread& operator=(const RenderThread &) = delete;
+	RenderThread& operator=(RenderThread &&) noexcept = delete;
+
+	/**
+	 * Get the target replaying the frames. Set it up with
+	 * RenderTarget::use() before start(), read its stats after
+	 * wait().
+	 */
+	RenderTarget& getTarget();
+
+	/**
+	 * Move the context of @window to the render thread and switch
+	 * the @recorder to recording mode.
+	 *
+	 * @param[in] window Window owning the context, current on the
+	 *            calling thread.
+	 * @param[in] recorder target the views draw to.
+	 */
+	void start(Window &window, RenderTarget &recorder);
+
+	/**
+	 * Draw the pending frames, stop the thread and make the
+	 * context current on the calling thread again.
+	 */
+	void stop();
+
+	/**
+	 * Start recording a frame, see RenderTarget::beginFrame().
+	 *
+	 * @retval true the frame must be drawn.
+	 * @retval false nothing changed, skip the frame.
+	 */
+	bool beginFrame();
+
+	/**
+	 * End the frame and hand it to the render thread, which
+	 * draws, presents and displays it.
+	 */
+	void endFrame();
+
+	/**
+	 * Wait until the frames handed to the render thread are drawn.
+	 */
+	void wait();
+
+private:
+	void run();
+
+private:
+	RenderTarget            mTarget;
+	FramePacket             mPackets[2];
+	Window                 *mWindow;
+	RenderTarget           *mRecorder;
+	std::thread             mThread;
+	std::mutex              mMutex;
+	std::condition_variable mCondition;
+	unsigned                mPublished;
+	unsigned                mDrawn;
+	bool                    mIsRunning;
+};
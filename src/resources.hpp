@@ -8,6 +8,7 @@ enum class ViewID
 	GamePlay,
 	GamePaused,
 	GameOver,
+	Benchmark,
 };
 
 enum class FontID
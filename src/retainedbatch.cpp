@@ -0,0 +1,79 @@
+#include <GL/glew.h>
+
+#include "glcheck.hpp"
+#include "retainedbatch.hpp"
+
+namespace
+{
+template <typename T>
+void
+uploadBuffer(unsigned target, unsigned &buffer, const std::vector<T> &data)
+{
+	if (data.empty())
+	{
+		return;
+	}
+
+	if (!buffer)
+	{
+		glCheck(glGenBuffers(1, &buffer));
+	}
+	glCheck(glBindBuffer(target, buffer));
+	glCheck(glBufferData(target, data.size() * sizeof(T), data.data(),
+			     GL_STATIC_DRAW));
+}
+}
+
+RetainedBatch::RetainedBatch()
+	: mVertexBuffer(0)
+	, mIndexBuffer(0)
+	, mQuadBuffer(0)
+	, mIsDirty(true)
+{
+}
+
+RetainedBatch::~RetainedBatch()
+{
+	for (auto buffer : { mVertexBuffer, mIndexBuffer, mQuadBuffer })
+	{
+		if (buffer)
+		{
+			glCheck(glDeleteBuffers(1, &buffer));
+		}
+	}
+}
+
+DrawList&
+RetainedBatch::edit()
+{
+	mIsDirty = true;
+	return mList;
+}
+
+void
+RetainedBatch::invalidate()
+{
+	mIsDirty = true;
+}
+
+void
+RetainedBatch::upload()
+{
+	// NOTE: unbind the vertex array to not change the index
+	// buffer of the pipelines.
+	glCheck(glBindVertexArray(0));
+
+	// the retained geometry samples only from the first unit
+	for (auto &vertex : mList.mVertices)
+	{
+		vertex.texture = 0;
+	}
+	for (auto &quad : mList.mQuads)
+	{
+		quad.texture = 0;
+	}
+	uploadBuffer(GL_ARRAY_BUFFER, mVertexBuffer, mList.mVertices);
+	uploadBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer, mList.mIndices);
+	uploadBuffer(GL_ARRAY_BUFFER, mQuadBuffer, mList.mQuads);
+	mIsDirty = false;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "drawlist.hpp"
+
+/**
+ * Geometry recorded once and kept in GPU buffers.
+ *
+ * The primitives are recorded in a DrawList, uploaded on the first
+ * RenderTarget::draw() after an edit and then replayed as they are,
+ * so static layers cost only their draw calls.
+ *
+ * The batch is always drawn in the standard vertex format and in
+ * the order it was recorded, without depth test: the vertex format
+ * and the depth sorting of the RenderTarget don't apply to it, only
+ * the quad expansion is followed.
+ */
+class RetainedBatch
+{
+public:
+	RetainedBatch();
+	~RetainedBatch();
+
+	RetainedBatch(const RetainedBatch &) = delete;
+	RetainedBatch(RetainedBatch &&) noexcept = delete;
+	RetainedBatch& operator=(const RetainedBatch &) = delete;
+	RetainedBatch& operator=(RetainedBatch &&) noexcept = delete;
+
+	/**
+	 * Get the list holding the geometry of the batch, the batch
+	 * is uploaded again on the next draw.
+	 */
+	DrawList& edit();
+
+	/**
+	 * Force the upload of the batch on the next draw.
+	 */
+	void invalidate();
+
+private:
+	friend class RenderTarget;
+
+	void upload();
+
+private:
+	DrawList mList;
+	unsigned mVertexBuffer;
+	unsigned mIndexBuffer;
+	unsigned mQuadBuffer;
+	bool     mIsDirty;
+};
@@ -7,6 +7,11 @@
 #include "shader.hpp"
 #include "utility.hpp"
 
+ShaderUniform::ShaderUniform()
+	: mLocation(-1)
+{
+}
+
 ShaderUniform::ShaderUniform(int location)
 	: mLocation(location)
 {
@@ -23,12 +28,36 @@ ShaderUniform::set(const glm::mat4 &matrix)
 			glm::value_ptr(matrix)));
 }
 
+void
+ShaderUniform::set(const glm::vec4 &vector)
+{
+	glCheck(glUniform4fv(mLocation, 1, glm::value_ptr(vector)));
+}
+
+void
+ShaderUniform::set(const glm::vec2 &vector)
+{
+	glCheck(glUniform2fv(mLocation, 1, glm::value_ptr(vector)));
+}
+
+void
+ShaderUniform::set(float value)
+{
+	glCheck(glUniform1f(mLocation, value));
+}
+
 void
 ShaderUniform::set(int value)
 {
 	glCheck(glUniform1i(mLocation, value));
 }
 
+void
+ShaderUniform::set(unsigned value)
+{
+	glCheck(glUniform1ui(mLocation, value));
+}
+
 Shader::Shader()
 	: mProgram(0)
 {
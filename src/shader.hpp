@@ -16,10 +16,15 @@ enum class ShaderType
 class ShaderUniform
 {
 public:
+	ShaderUniform();
 	explicit ShaderUniform(int location);
 
 	void set(const glm::mat4 &matrix);
+	void set(const glm::vec4 &vector);
+	void set(const glm::vec2 &vector);
+	void set(float value);
 	void set(int value);
+	void set(unsigned value);
 
 private:
 	int mLocation;
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "rendertarget.hpp"
+#include "spritebatch.hpp"
+#include "vertex.hpp"
+
+namespace
+{
+const float DegToRad = 0.017453292519943295f;
+
+// corners in the order expected by RenderTarget::getQuadVertexArray()
+const int CornerX[4] = { 0, 0, 1, 1 };
+const int CornerY[4] = { 0, 1, 0, 1 };
+
+// the sprites are read in order or through the list of visible ones
+struct Contiguous
+{
+	std::size_t operator()(std::size_t i) const
+	{
+		return i;
+	}
+};
+
+struct Indexed
+{
+	const std::uint32_t *indices;
+
+	std::size_t operator()(std::size_t i) const
+	{
+		return indices[i];
+	}
+};
+
+#if defined(__SSE2__)
+__m128
+load4(const std::vector<float> &array, std::size_t i, Contiguous)
+{
+	return _mm_loadu_ps(&array[i]);
+}
+
+__m128
+load4(const std::vector<float> &array, std::size_t i, Indexed access)
+{
+	return _mm_setr_ps(array[access(i)], array[access(i + 1)],
+			   array[access(i + 2)], array[access(i + 3)]);
+}
+
+static_assert(offsetof(Vertex, uv) == 2 * sizeof(float),
+	      "the kernel writes position and uv with a single store");
+
+/**
+ * Compute sine and cosine of four angles in radians.
+ *
+ * The angles are reduced to [-pi/4, pi/4] and the quadrant selects
+ * the polynomial and the sign (coefficients from Cephes).
+ */
+void
+sincos4(__m128 x, __m128 &sin, __m128 &cos)
+{
+	const __m128i quadrant = _mm_cvtps_epi32(
+		_mm_mul_ps(x, _mm_set1_ps(0.63661977236758134f)));
+	const __m128 q = _mm_cvtepi32_ps(quadrant);
+	x = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(1.5703125f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(4.837512969970703125e-4f)));
+	x = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(7.54978995489188216e-8f)));
+
+	const __m128 z = _mm_mul_ps(x, x);
+	__m128 s = _mm_set1_ps(-1.9515295891e-4f);
+	s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(8.3321608736e-3f));
+	s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(-1.6666654611e-1f));
+	s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+
+	__m128 c = _mm_set1_ps(2.443315711809948e-5f);
+	c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(-1.388731625493765e-3f));
+	c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(4.166664568298827e-2f));
+	c = _mm_mul_ps(_mm_mul_ps(c, z), z);
+	c = _mm_sub_ps(c, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+	c = _mm_add_ps(c, _mm_set1_ps(1.f));
+
+	// odd quadrants swap sine and cosine
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i two = _mm_set1_epi32(2);
+	const __m128 swap = _mm_castsi128_ps(
+		_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+	sin = _mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s));
+	cos = _mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c));
+
+	// move bit 1 of the quadrant to the sign bit
+	const __m128 sinSign = _mm_castsi128_ps(
+		_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+	const __m128 cosSign = _mm_castsi128_ps(
+		_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+	sin = _mm_xor_ps(sin, sinSign);
+	cos = _mm_xor_ps(cos, cosSign);
+}
+#endif
+}
+
+SpriteBatch::SpriteBatch()
+{
+}
+
+void
+SpriteBatch::clear()
+{
+	for (auto array : { &mPosX, &mPosY, &mSizeX, &mSizeY,
+			    &mOriginX, &mOriginY, &mRotation,
+			    &mUVX, &mUVY, &mUVWidth, &mUVHeight })
+	{
+		array->clear();
+	}
+	mColor.clear();
+}
+
+void
+SpriteBatch::reserve(std::size_t count)
+{
+	for (auto array : { &mPosX, &mPosY, &mSizeX, &mSizeY,
+			    &mOriginX, &mOriginY, &mRotation,
+			    &mUVX, &mUVY, &mUVWidth, &mUVHeight })
+	{
+		array->reserve(count);
+	}
+	mColor.reserve(count);
+}
+
+std::size_t
+SpriteBatch::size() const
+{
+	return mColor.size();
+}
+
+void
+SpriteBatch::add(glm::vec2 position, glm::vec2 size, glm::vec2 origin,
+		 float rotation, const FloatRect &uvRect, Color color)
+{
+	mPosX.push_back(position.x);
+	mPosY.push_back(position.y);
+	mSizeX.push_back(size.x);
+	mSizeY.push_back(size.y);
+	mOriginX.push_back(origin.x);
+	mOriginY.push_back(origin.y);
+	mRotation.push_back(rotation * DegToRad);
+	mUVX.push_back(uvRect.pos.x);
+	mUVY.push_back(uvRect.pos.y);
+	mUVWidth.push_back(uvRect.size.x);
+	mUVHeight.push_back(uvRect.size.y);
+	mColor.push_back(color);
+}
+
+void
+SpriteBatch::draw(RenderTarget &target, const Texture *texture) const
+{
+	// keep the sprites whose bounding circle around the origin
+	// touches the camera bounds
+	mVisible.clear();
+	for (std::size_t i = 0; i < mColor.size(); i++)
+	{
+		const float dx = std::max(mOriginX[i], mSizeX[i] - mOriginX[i]);
+		const float dy = std::max(mOriginY[i], mSizeY[i] - mOriginY[i]);
+		const float radius = std::sqrt(dx * dx + dy * dy);
+		const FloatRect bounds(
+			glm::vec2(mPosX[i] - radius, mPosY[i] - radius),
+			glm::vec2(radius * 2.f));
+		if (target.isVisible(bounds))
+		{
+			mVisible.push_back(i);
+		}
+	}
+
+	if (mVisible.empty())
+	{
+		return;
+	}
+
+	target.setTexture(texture);
+	Vertex *vertices = target.getQuadVertexArray(mVisible.size());
+	if (mVisible.size() == mColor.size())
+	{
+		expand(vertices, mColor.size(), Contiguous{});
+	}
+	else
+	{
+		expand(vertices, mVisible.size(), Indexed{ mVisible.data() });
+	}
+}
+
+template <typename Access>
+void
+SpriteBatch::expand(Vertex *vertices, std::size_t count, Access access) const
+{
+	std::size_t i = 0;
+
+#if defined(__SSE2__)
+	for (; i + 4 <= count; i += 4, vertices += 16)
+	{
+		const __m128 px = load4(mPosX, i, access);
+		const __m128 py = load4(mPosY, i, access);
+		const __m128 ox = load4(mOriginX, i, access);
+		const __m128 oy = load4(mOriginY, i, access);
+		const __m128 u = load4(mUVX, i, access);
+		const __m128 v = load4(mUVY, i, access);
+
+		__m128 sin, cos;
+		sincos4(load4(mRotation, i, access), sin, cos);
+
+		// local coordinates of the corners relative to the origin
+		const __m128 left = _mm_sub_ps(_mm_setzero_ps(), ox);
+		const __m128 top = _mm_sub_ps(_mm_setzero_ps(), oy);
+		const __m128 local[2][2] = {
+			{ left, _mm_add_ps(left, load4(mSizeX, i, access)) },
+			{ top, _mm_add_ps(top, load4(mSizeY, i, access)) },
+		};
+		const __m128 uv[2][2] = {
+			{ u, _mm_add_ps(u, load4(mUVWidth, i, access)) },
+			{ v, _mm_add_ps(v, load4(mUVHeight, i, access)) },
+		};
+
+		for (int corner = 0; corner < 4; corner++)
+		{
+			const __m128 lx = local[0][CornerX[corner]];
+			const __m128 ly = local[1][CornerY[corner]];
+			__m128 x = _mm_add_ps(px, _mm_sub_ps(_mm_mul_ps(lx, cos),
+							    _mm_mul_ps(ly, sin)));
+			__m128 y = _mm_add_ps(py, _mm_add_ps(_mm_mul_ps(lx, sin),
+							    _mm_mul_ps(ly, cos)));
+			__m128 cu = uv[0][CornerX[corner]];
+			__m128 cv = uv[1][CornerY[corner]];
+
+			// one row of (x, y, u, v) for each sprite
+			_MM_TRANSPOSE4_PS(x, y, cu, cv);
+			const __m128 rows[4] = { x, y, cu, cv };
+			for (int j = 0; j < 4; j++)
+			{
+				Vertex &vertex = vertices[j * 4 + corner];
+				_mm_storeu_ps(&vertex.pos.x, rows[j]);
+				vertex.color = mColor[access(i + j)];
+			}
+		}
+	}
+#endif
+
+	for (; i < count; i++, vertices += 4)
+	{
+		const std::size_t k = access(i);
+		const float sin = std::sin(mRotation[k]);
+		const float cos = std::cos(mRotation[k]);
+		for (int corner = 0; corner < 4; corner++)
+		{
+			const float lx = CornerX[corner] * mSizeX[k] - mOriginX[k];
+			const float ly = CornerY[corner] * mSizeY[k] - mOriginY[k];
+			Vertex &vertex = vertices[corner];
+			vertex.pos.x = mPosX[k] + lx * cos - ly * sin;
+			vertex.pos.y = mPosY[k] + lx * sin + ly * cos;
+			vertex.uv.x = mUVX[k] + CornerX[corner] * mUVWidth[k];
+			vertex.uv.y = mUVY[k] + CornerY[corner] * mUVHeight[k];
+			vertex.color = mColor[k];
+		}
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "color.hpp"
+#include "rect.hpp"
+
+class RenderTarget;
+class Texture;
+struct Vertex;
+
+/**
+ * A set of rotated and scaled sprites sharing a texture.
+ *
+ * The sprites are stored as structure of arrays and their corners
+ * are computed four sprites at a time with SSE when available.
+ */
+class SpriteBatch
+{
+public:
+	SpriteBatch();
+
+	/**
+	 * Remove all the sprites, the memory is kept.
+	 */
+	void clear();
+
+	/**
+	 * Reserve space for @count sprites.
+	 */
+	void reserve(std::size_t count);
+
+	/**
+	 * Get the number of sprites.
+	 */
+	std::size_t size() const;
+
+	/**
+	 * Add a sprite to the batch.
+	 *
+	 * @param[in] position position of the origin in world space.
+	 * @param[in] size size of the sprite.
+	 * @param[in] origin origin relative to the top-left corner.
+	 * @param[in] rotation rotation around the origin in degrees.
+	 * @param[in] uvRect texture rectangle in normalized coordinates.
+	 * @param[in] color color of the sprite.
+	 */
+	void add(glm::vec2 position, glm::vec2 size, glm::vec2 origin,
+		 float rotation, const FloatRect &uvRect, Color color);
+
+	/**
+	 * Add the sprites to the current batch of the @target, the
+	 * sprites out of the camera bounds are skipped.
+	 *
+	 * @param[in] target the RenderTarget.
+	 * @param[in] texture texture of the sprites.
+	 */
+	void draw(RenderTarget &target, const Texture *texture) const;
+
+private:
+	template <typename Access>
+	void expand(Vertex *vertices, std::size_t count, Access access) const;
+
+private:
+	std::vector<float>         mPosX;
+	std::vector<float>         mPosY;
+	std::vector<float>         mSizeX;
+	std::vector<float>         mSizeY;
+	std::vector<float>         mOriginX;
+	std::vector<float>         mOriginY;
+	std::vector<float>         mRotation;
+	std::vector<float>         mUVX;
+	std::vector<float>         mUVY;
+	std::vector<float>         mUVWidth;
+	std::vector<float>         mUVHeight;
+	std::vector<std::uint32_t> mColor;
+
+	mutable std::vector<std::uint32_t> mVisible;
+};
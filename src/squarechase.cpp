@@ -1,19 +1,89 @@
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include "application.hpp"
+#include "framesync.hpp"
+
+namespace
+{
+// frames drawn by --headless when --frames is missing
+const unsigned DefaultFrames = 600;
+
+void
+usage(const char *name)
+{
+	std::cout << "usage: " << name
+		  << " [--headless] [--frames N] [--frames-in-flight N] [--profile]\n"
+		  << "  --headless  render offscreen without showing a window\n"
+		  << "  --frames N  draw N frames of the sprite benchmark, print the frame time\n"
+		  << "  --frames-in-flight N  let the GPU lag N frames behind, 1 to "
+		  << FrameSync::MaxDepth << " (default 2)\n"
+		  << "  --profile   measure the GPU time of the views and textures\n";
+}
+}
 
 int main(int argc, char **argv)
 {
-	if(argc != 1)
+	bool headless = false;
+	bool profile = false;
+	unsigned frames = 0;
+	unsigned framesInFlight = 2;
+	for (int i = 1; i < argc; i++)
 	{
-		std::cout << argv[0] << " takes no arguments.\n";
-		return 1;
+		if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (std::strcmp(argv[i], "--profile") == 0)
+		{
+			profile = true;
+		}
+		else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+		{
+			char *end;
+			frames = std::strtoul(argv[++i], &end, 10);
+			if (*end != '\0' || frames == 0)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--frames-in-flight") == 0 && i + 1 < argc)
+		{
+			char *end;
+			framesInFlight = std::strtoul(argv[++i], &end, 10);
+			if (*end != '\0' || framesInFlight == 0
+			    || framesInFlight > FrameSync::MaxDepth)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+		}
+		else
+		{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (headless && frames == 0)
+	{
+		frames = DefaultFrames;
 	}
 
 	try
 	{
-		Application app;
-		app.run();
+		Application app(headless);
+		app.setProfiling(profile);
+		app.setFramesInFlight(framesInFlight);
+		if (frames)
+		{
+			app.runFrames(frames);
+		}
+		else
+		{
+			app.run();
+		}
 		return 0;
 	}
 	catch (const std::exception &e)
@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#include <GL/glew.h>
+
+#include "framesync.hpp"
+#include "glcheck.hpp"
+#include "streambuffer.hpp"
+
+namespace
+{
+std::size_t
+roundUp(std::size_t value, std::size_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+}
+
+StreamBuffer::StreamBuffer()
+	: mFences{}
+	, mTarget(0)
+	, mBuffer(0)
+	, mIsPersistent(false)
+	, mStorage(nullptr)
+	, mSegmentSize(0)
+	, mSegment(0)
+	, mCursor(0)
+	, mMapOffset(0)
+	, mMapSize(0)
+	, mIsOpen(false)
+	, mRangeOffset(0)
+	, mRangeAlignment(1)
+	, mRangeData(nullptr)
+	, mGeneration(0)
+{
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	release();
+}
+
+void
+StreamBuffer::create(unsigned target, std::size_t segmentSize)
+{
+	mTarget = target;
+	mIsPersistent = GLEW_ARB_buffer_storage;
+	allocate(segmentSize);
+}
+
+void *
+StreamBuffer::map(std::size_t size, std::size_t alignment)
+{
+	assert(mBuffer && "StreamBuffer not created");
+	assert(mMapSize == 0 && !mIsOpen && "StreamBuffer already mapped");
+
+	std::size_t offset = roundUp(mCursor, alignment);
+	if (offset + size > (mSegment + 1) * mSegmentSize)
+	{
+		reserve(size + alignment);
+		offset = roundUp(mCursor, alignment);
+	}
+
+	mMapOffset = offset;
+	mMapSize = size;
+	mCursor = offset + size;
+
+	if (mIsPersistent)
+	{
+		return static_cast<char *>(mStorage) + offset;
+	}
+
+	glCheck(glBindBuffer(mTarget, mBuffer));
+	void *ptr;
+	glCheck(ptr = glMapBufferRange(
+			mTarget, offset, size,
+			GL_MAP_WRITE_BIT
+			| GL_MAP_INVALIDATE_RANGE_BIT
+			| GL_MAP_UNSYNCHRONIZED_BIT));
+	if (!ptr)
+	{
+		throw std::runtime_error("StreamBuffer::map() - cannot map the buffer");
+	}
+	return ptr;
+}
+
+std::size_t
+StreamBuffer::unmap()
+{
+	assert(mMapSize && "StreamBuffer not mapped");
+	if (!mIsPersistent)
+	{
+		glCheck(glBindBuffer(mTarget, mBuffer));
+		glCheck(glUnmapBuffer(mTarget));
+	}
+	mMapSize = 0;
+	return mMapOffset;
+}
+
+void
+StreamBuffer::begin(std::size_t alignment)
+{
+	assert(mBuffer && "StreamBuffer not created");
+	assert(mMapSize == 0 && !mIsOpen && "StreamBuffer already mapped");
+
+	// the range is mapped by the first append()
+	mIsOpen = true;
+	mRangeAlignment = alignment;
+	mRangeOffset = roundUp(mCursor, alignment);
+	if (mRangeOffset >= (mSegment + 1) * mSegmentSize)
+	{
+		nextSegment();
+		mRangeOffset = roundUp(mCursor, alignment);
+	}
+	mCursor = mRangeOffset;
+}
+
+void *
+StreamBuffer::append(std::size_t size, std::size_t alignment)
+{
+	assert(mIsOpen && "StreamBuffer range not open");
+
+	std::size_t offset = mRangeOffset + roundUp(mCursor - mRangeOffset, alignment);
+	if (offset + size > (mSegment + 1) * mSegmentSize)
+	{
+		moveRange(offset - mRangeOffset + size);
+		offset = mRangeOffset + roundUp(mCursor - mRangeOffset, alignment);
+	}
+
+	if (!mRangeData)
+	{
+		mapRange();
+	}
+	mCursor = offset + size;
+	return mRangeData + (offset - mRangeOffset);
+}
+
+std::size_t
+StreamBuffer::getRangeSize() const
+{
+	return mCursor - mRangeOffset;
+}
+
+bool
+StreamBuffer::isOpen() const
+{
+	return mIsOpen;
+}
+
+std::size_t
+StreamBuffer::end()
+{
+	assert(mIsOpen && "StreamBuffer range not open");
+	unmapRange();
+	mIsOpen = false;
+	return mRangeOffset;
+}
+
+void
+StreamBuffer::bind() const
+{
+	glCheck(glBindBuffer(mTarget, mBuffer));
+}
+
+unsigned
+StreamBuffer::getHandle() const
+{
+	return mBuffer;
+}
+
+unsigned
+StreamBuffer::getGeneration() const
+{
+	return mGeneration;
+}
+
+void
+StreamBuffer::reserve(std::size_t size)
+{
+	// grow the storage if the range cannot fit in a segment
+	if (size > mSegmentSize)
+	{
+		allocate(std::max(size, mSegmentSize * 2));
+	}
+	else if (mCursor + size > (mSegment + 1) * mSegmentSize)
+	{
+		nextSegment();
+	}
+}
+
+void
+StreamBuffer::allocate(std::size_t segmentSize)
+{
+	// NOTE: the old storage is released or orphaned, the GPU
+	// keeps it alive until it's done with it.
+	releaseFences();
+	const std::size_t size = segmentSize * SegmentCount;
+	mSegmentSize = segmentSize;
+	mSegment = 0;
+	mCursor = 0;
+	mGeneration++;
+
+	if (mIsPersistent)
+	{
+		// immutable storage cannot be resized, we need a new buffer
+		release();
+		const GLbitfield flags = GL_MAP_WRITE_BIT
+			| GL_MAP_PERSISTENT_BIT
+			| GL_MAP_COHERENT_BIT;
+
+		glCheck(glGenBuffers(1, &mBuffer));
+		glCheck(glBindBuffer(mTarget, mBuffer));
+		glCheck(glBufferStorage(mTarget, size, nullptr, flags));
+		glCheck(mStorage = glMapBufferRange(mTarget, 0, size, flags));
+		if (!mStorage)
+		{
+			throw std::runtime_error("StreamBuffer::allocate() - "
+						 "cannot map the buffer storage");
+		}
+	}
+	else
+	{
+		if (!mBuffer)
+		{
+			glCheck(glGenBuffers(1, &mBuffer));
+		}
+		glCheck(glBindBuffer(mTarget, mBuffer));
+		glCheck(glBufferData(mTarget, size, nullptr, GL_STREAM_DRAW));
+	}
+}
+
+void
+StreamBuffer::nextSegment()
+{
+	// the draws reading the segment left are fenced and the GPU
+	// must be done with the next one.
+	mFences[mSegment] = FrameSync::fence();
+	mSegment = (mSegment + 1) % SegmentCount;
+	FrameSync::wait(mFences[mSegment]);
+	mFences[mSegment] = nullptr;
+	mCursor = mSegment * mSegmentSize;
+}
+
+void
+StreamBuffer::moveRange(std::size_t size)
+{
+	// the CPU never reads the mapped memory back, the bytes of the
+	// range written so far are copied by the GPU.
+	unmapRange();
+	const std::size_t used = mCursor - mRangeOffset;
+	const unsigned source = mBuffer;
+	const std::size_t sourceOffset = mRangeOffset;
+	void *sourceStorage = mStorage;
+
+	const bool grow = size + mRangeAlignment > mSegmentSize;
+	if (grow)
+	{
+		// keep the old storage alive until the copy is queued
+		mBuffer = 0;
+		mStorage = nullptr;
+		allocate(std::max(size + mRangeAlignment, mSegmentSize * 2));
+		mRangeOffset = 0;
+	}
+	else
+	{
+		mRangeOffset = roundUp((mSegment + 1) % SegmentCount * mSegmentSize,
+				       mRangeAlignment);
+	}
+
+	if (used)
+	{
+		glCheck(glBindBuffer(GL_COPY_READ_BUFFER, source));
+		glCheck(glBindBuffer(GL_COPY_WRITE_BUFFER, mBuffer));
+		glCheck(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+					    sourceOffset, mRangeOffset, used));
+	}
+
+	if (grow)
+	{
+		if (sourceStorage)
+		{
+			glCheck(glBindBuffer(mTarget, source));
+			glCheck(glUnmapBuffer(mTarget));
+		}
+		glCheck(glDeleteBuffers(1, &source));
+	}
+	else
+	{
+		// the copy is queued before the fence of the segment left
+		nextSegment();
+	}
+	mCursor = mRangeOffset + used;
+}
+
+void
+StreamBuffer::mapRange()
+{
+	if (mIsPersistent)
+	{
+		mRangeData = static_cast<char *>(mStorage) + mRangeOffset;
+		return;
+	}
+
+	// map the rest of the segment, only the part written is flushed
+	glCheck(glBindBuffer(mTarget, mBuffer));
+	void *ptr;
+	glCheck(ptr = glMapBufferRange(
+			mTarget, mRangeOffset,
+			(mSegment + 1) * mSegmentSize - mRangeOffset,
+			GL_MAP_WRITE_BIT
+			| GL_MAP_INVALIDATE_RANGE_BIT
+			| GL_MAP_UNSYNCHRONIZED_BIT
+			| GL_MAP_FLUSH_EXPLICIT_BIT));
+	if (!ptr)
+	{
+		throw std::runtime_error("StreamBuffer::append() - cannot map the buffer");
+	}
+	mRangeData = static_cast<char *>(ptr);
+}
+
+void
+StreamBuffer::unmapRange()
+{
+	if (!mRangeData)
+	{
+		return;
+	}
+
+	if (!mIsPersistent)
+	{
+		glCheck(glBindBuffer(mTarget, mBuffer));
+		if (mCursor > mRangeOffset)
+		{
+			glCheck(glFlushMappedBufferRange(mTarget, 0, mCursor - mRangeOffset));
+		}
+		glCheck(glUnmapBuffer(mTarget));
+	}
+	mRangeData = nullptr;
+}
+
+void
+StreamBuffer::releaseFences()
+{
+	for (auto &fence : mFences)
+	{
+		FrameSync::release(fence);
+		fence = nullptr;
+	}
+}
+
+void
+StreamBuffer::release()
+{
+	releaseFences();
+	if (!mBuffer)
+	{
+		return;
+	}
+
+	if (mStorage)
+	{
+		glCheck(glBindBuffer(mTarget, mBuffer));
+		glCheck(glUnmapBuffer(mTarget));
+		mStorage = nullptr;
+	}
+	glCheck(glDeleteBuffers(1, &mBuffer));
+	mBuffer = 0;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * A GPU buffer used as a ring of equally sized segments.
+ *
+ * Data is written directly into GPU visible memory: when
+ * ARB_buffer_storage is available the whole buffer is persistently
+ * mapped once, otherwise each range is mapped unsynchronized with
+ * glMapBufferRange(). A segment is fenced when the ring leaves it
+ * and the fence is waited before writing it again.
+ *
+ * Data of unknown size is written in an open range, see begin(),
+ * moved by the GPU when it outgrows the space left in the segment.
+ */
+class StreamBuffer
+{
+public:
+	StreamBuffer();
+	~StreamBuffer();
+
+	StreamBuffer(const StreamBuffer &) = delete;
+	StreamBuffer(StreamBuffer &&) noexcept = delete;
+	StreamBuffer& operator=(const StreamBuffer &) = delete;
+	StreamBuffer& operator=(StreamBuffer &&) noexcept = delete;
+
+	/**
+	 * Create the storage of the buffer.
+	 *
+	 * @param[in] target binding point of the buffer (GL_ARRAY_BUFFER, ...).
+	 * @param[in] segmentSize size in bytes of a single segment.
+	 */
+	void create(unsigned target, std::size_t segmentSize);
+
+	/**
+	 * Reserve a range of @size bytes in the current segment and
+	 * return a pointer to write into it.
+	 *
+	 * @param[in] size size in bytes of the range.
+	 * @param[in] alignment alignment in bytes of the range offset.
+	 */
+	void *map(std::size_t size, std::size_t alignment);
+
+	/**
+	 * Complete the writes to the range returned by map().
+	 *
+	 * @return the offset in bytes of the range inside the buffer.
+	 */
+	std::size_t unmap();
+
+	/**
+	 * Open a range growing with append() until end(), nothing else
+	 * can be mapped meanwhile.
+	 *
+	 * @param[in] alignment alignment in bytes of the range offset.
+	 */
+	void begin(std::size_t alignment);
+
+	/**
+	 * Add @size bytes at the end of the open range and return a
+	 * pointer to write into them. The pointer is valid until the
+	 * next call: when the range doesn't fit in the segment anymore
+	 * the bytes written so far are copied by the GPU to the next
+	 * segment or to a larger storage.
+	 *
+	 * @param[in] size size in bytes to add.
+	 * @param[in] alignment alignment in bytes of the added bytes
+	 * from the start of the range.
+	 */
+	void *append(std::size_t size, std::size_t alignment);
+
+	/**
+	 * Get the size in bytes of the open range.
+	 */
+	std::size_t getRangeSize() const;
+
+	/**
+	 * Tell if a range is open.
+	 */
+	bool isOpen() const;
+
+	/**
+	 * Complete the writes to the open range.
+	 *
+	 * @return the offset in bytes of the range inside the buffer.
+	 */
+	std::size_t end();
+
+	/**
+	 * Bind the buffer to its binding point.
+	 */
+	void bind() const;
+
+	/**
+	 * Get the OpenGL name of the buffer, it can change when the
+	 * storage grows.
+	 */
+	unsigned getHandle() const;
+
+	/**
+	 * Get a number changed every time the storage is replaced, the
+	 * vertex layouts set on the old storage must be set again even
+	 * if the name is reused.
+	 */
+	unsigned getGeneration() const;
+
+private:
+	// NOTE: with three segments the CPU writes one segment while
+	// the GPU may still be reading from the other two.
+	static const unsigned SegmentCount = 3;
+
+private:
+	void reserve(std::size_t size);
+	void allocate(std::size_t segmentSize);
+	void nextSegment();
+	void moveRange(std::size_t size);
+	void mapRange();
+	void unmapRange();
+	void release();
+	void releaseFences();
+
+private:
+	void        *mFences[SegmentCount];
+	unsigned     mTarget;
+	unsigned     mBuffer;
+	bool         mIsPersistent;
+	void        *mStorage;
+	std::size_t  mSegmentSize;
+	unsigned     mSegment;
+	std::size_t  mCursor;
+	std::size_t  mMapOffset;
+	std::size_t  mMapSize;
+	bool         mIsOpen;
+	std::size_t  mRangeOffset;
+	std::size_t  mRangeAlignment;
+	char        *mRangeData;
+	unsigned     mGeneration;
+};
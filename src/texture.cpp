@@ -1,5 +1,7 @@
 #include <cassert>
 #include <iostream>
+#include <mutex>
+#include <vector>
 
 #include <GL/glew.h>
 
@@ -7,8 +9,38 @@
 #include "texture.hpp"
 #include "stb_image.h"
 
+namespace
+{
+// the textures can be created and destroyed on the render thread
+// while the game thread loads its own
+std::mutex slotMutex;
+std::vector<unsigned> freeSlots;
+unsigned slotCount = 0;
+
+unsigned
+acquireSlot()
+{
+	std::lock_guard<std::mutex> lock(slotMutex);
+	if (freeSlots.empty())
+	{
+		return slotCount++;
+	}
+	unsigned slot = freeSlots.back();
+	freeSlots.pop_back();
+	return slot;
+}
+
+void
+releaseSlot(unsigned slot)
+{
+	std::lock_guard<std::mutex> lock(slotMutex);
+	freeSlots.push_back(slot);
+}
+}
+
 Texture::Texture()
 	: mTexture(0)
+	, mSlot(acquireSlot())
 {
 }
 
@@ -18,10 +50,14 @@ Texture::~Texture()
 	{
 		glCheck(glDeleteTextures(1, &mTexture));
 	}
+	releaseSlot(mSlot);
 }
 
+// NOTE: the slot identifies the Texture object, only the OpenGL
+// texture is moved.
 Texture::Texture(Texture &&other) noexcept
 	: mTexture(0)
+	, mSlot(acquireSlot())
 {
 	std::swap(mTexture, other.mTexture);
 }
@@ -261,6 +297,12 @@ Texture::setRepeated(bool repeated)
 	glCheck(glBindTexture(GL_TEXTURE_2D, 0));
 }
 
+unsigned
+Texture::getSlot() const
+{
+	return mSlot;
+}
+
 bool
 Texture::isSmooth() const
 {
@@ -37,8 +37,17 @@ public:
 	bool isSmooth() const;
 	void setSmooth(bool smooth);
 
+	/**
+	 * Get the small integer identifying the texture, the slots
+	 * are reused when the textures are destroyed.
+	 */
+	unsigned getSlot() const;
+
 	static void bind(const Texture *texture, int textureUnit) noexcept;
 
 private:
 	unsigned mTexture;
+	unsigned mSlot;
+
+	friend class RenderTexture;
 };
@@ -3,9 +3,67 @@
 #include <cstdint>
 #include <glm/glm.hpp>
 
+/**
+ * A textured vertex. The texture field is the index of the texture
+ * unit to sample from, it's set by the RenderTarget when the vertex
+ * is added to the batch.
+ */
 struct Vertex
 {
 	glm::vec2 pos;
 	glm::vec2 uv;
 	std::uint32_t color;
+	std::uint32_t texture;
+};
+
+/**
+ * A 12 bytes vertex: the position is rounded to whole units in the
+ * [-32768, 32767] range and the texture coordinates are normalized
+ * 16-bit values, so they must be in the [0, 1] range.
+ */
+struct CompactVertex
+{
+	std::int16_t x, y;
+	std::uint16_t u, v;
+	std::uint32_t color;
+};
+
+/**
+ * Format of the vertices sent to the GPU.
+ */
+enum class VertexFormat
+{
+	Standard,
+	/// CompactVertex, quantized in world space before the camera
+	/// transform: positions rounded to whole units and clamped to
+	/// 16 bits, texture coordinates clamped to [0, 1]. Zoomed or
+	/// rotated cameras show the steps, sub-unit motion snaps, large
+	/// worlds and repeated textures don't fit. Debug builds assert
+	/// when a value is clamped.
+	Compact,
+};
+
+/**
+ * How the quads are turned into triangles on the GPU.
+ */
+enum class QuadExpansion
+{
+	/// four instanced vertices per quad, expanded in the vertex shader
+	Instancing,
+	/// one point per quad, expanded in a geometry shader
+	Points,
+};
+
+/**
+ * A textured quad drawn with instancing or as a point, the corners
+ * are expanded on the GPU, see QuadExpansion.
+ */
+struct Quad
+{
+	glm::vec2 pos;
+	glm::vec2 size;
+	glm::vec2 uvPos;
+	glm::vec2 uvSize;
+	std::uint32_t color;
+	std::uint32_t texture;
 };
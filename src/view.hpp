@@ -31,6 +31,10 @@ public:
 	 *
 	 * @retval true don't update underlying view.
 	 * @retval false update underlying view.
+	 *
+	 * NOTE: the views not updated are drawn once into a cached
+	 * RenderTexture, they must change only in update() or
+	 * handleEvent().
 	 */
 	virtual bool update(float dt) = 0;
 
@@ -45,7 +49,11 @@ public:
 	virtual bool handleEvent(const Event &event) = 0;
 
 	/**
-	 * Render the view using the @target.
+	 * Render the view using the @target. The frames are drawn
+	 * only when damaged: a view must report its changes with
+	 * RenderTarget::invalidate(). The target can be recording
+	 * the frame for a RenderThread, the view must not call
+	 * OpenGL directly.
 	 *
 	 * @param[in] target Reference to a RenderTarget class.
 	 */
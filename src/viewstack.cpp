@@ -1,17 +1,37 @@
 #include <cassert>
+#include <iterator>
 
 #include "viewstack.hpp"
 #include "rendertarget.hpp"
 
+namespace
+{
+// labels of the GPU time of the views
+const char *viewNames[] = {
+	"None",
+	"Menu",
+	"Settings",
+	"GamePlay",
+	"GamePaused",
+	"GameOver",
+	"Benchmark",
+};
+}
+
 ViewStack::ViewStack(const Context &context)
 	: mContext(context)
+	, mFrozenViews(0)
+	, mCachedViews(0)
 {
 }
 
 bool
 ViewStack::update(float dt)
 {
+	// NOTE: the views below the one blocking the update don't
+	// change, they can be rendered from the cache.
 	bool handled = false;
+	mFrozenViews = 0;
 	for (auto it = mStack.rbegin(), end = mStack.rend();
 	     it != end;
 	     ++it)
@@ -19,6 +39,7 @@ ViewStack::update(float dt)
 		handled = (*it)->update(dt);
 		if (handled)
 		{
+			mFrozenViews = std::distance(it, end) - 1;
 			break;
 		}
 	}
@@ -34,6 +55,12 @@ ViewStack::handleEvent(const Event &event)
 	     it != end;
 	     ++it)
 	{
+		// a cached view can change while handling an event
+		if (static_cast<std::size_t>(std::distance(it, end)) <= mCachedViews)
+		{
+			mCache.invalidate();
+		}
+
 		handled = (*it)->handleEvent(event);
 		if (handled)
 		{
@@ -47,10 +74,57 @@ ViewStack::handleEvent(const Event &event)
 void
 ViewStack::render(RenderTarget &target)
 {
-	for (auto &view: mStack)
+	std::size_t first = 0;
+	if (mFrozenViews)
 	{
-		view->render(target);
+		renderCache(target);
+		first = mFrozenViews;
 	}
+
+	for (std::size_t i = first; i < mStack.size(); i++)
+	{
+		target.setProfileLabel(viewNames[static_cast<int>(mStackIDs[i])]);
+		mStack[i]->render(target);
+	}
+	target.setProfileLabel(nullptr);
+}
+
+void
+ViewStack::renderCache(RenderTarget &target)
+{
+	// the cache covers the default camera
+	const Camera &camera = target.getDefaultCamera();
+	const glm::vec2 size = camera.getSize();
+	const FloatRect bounds{ camera.getCenter() - size * 0.5f, size };
+
+	// NOTE: the texture is created when drawn, the render thread
+	// owns the context.
+	if (mCache.getSize() != glm::ivec2(size))
+	{
+		mCache.setSize(size.x, size.y);
+	}
+
+	// draw the frozen views only when they changed
+	if (mCache.isDirty() || mCachedViews != mFrozenViews)
+	{
+		target.setRenderTexture(&mCache);
+		for (std::size_t i = 0; i < mFrozenViews; i++)
+		{
+			target.setProfileLabel(viewNames[static_cast<int>(mStackIDs[i])]);
+			mStack[i]->render(target);
+		}
+		target.setRenderTexture(nullptr);
+		mCachedViews = mFrozenViews;
+	}
+
+	const Camera current = target.getCamera();
+	target.setProfileLabel("ViewCache");
+	target.setCamera(camera);
+	target.setBlendMode(BlendMode::None);
+	target.draw(mCache, bounds);
+	target.draw();
+	target.setBlendMode(BlendMode::Alpha);
+	target.setCamera(current);
 }
 
 void
@@ -88,20 +162,32 @@ ViewStack::createState(ViewID viewID)
 void
 ViewStack::applyPendingChanges()
 {
+	// the cached views can move in the stack and the views
+	// must be drawn again.
+	if (!mPendingChanges.empty())
+	{
+		mFrozenViews = mCachedViews = 0;
+		mCache.invalidate();
+		mContext.target->invalidate();
+	}
+
 	for (const auto &change: mPendingChanges)
 	{
 		switch (change.action)
 		{
 		case Push:
 			mStack.push_back(createState(change.viewID));
+			mStackIDs.push_back(change.viewID);
 			break;
 
 		case Pop:
 			mStack.pop_back();
+			mStackIDs.pop_back();
 			break;
 
 		case Clear:
 			mStack.clear();
+			mStackIDs.clear();
 			break;
 		}
 	}
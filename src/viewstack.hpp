@@ -5,6 +5,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "rendertexture.hpp"
 #include "resources.hpp"
 
 #include "view.hpp"
@@ -41,11 +42,16 @@ private:
 	};
 	View::Ptr createState(ViewID viewID);
 	void applyPendingChanges();
+	void renderCache(RenderTarget &target);
 
 private:
 	Context mContext;
 	std::vector<View::Ptr> mStack;
+	std::vector<ViewID> mStackIDs;
 	std::vector<PendingChange> mPendingChanges;
+	RenderTexture mCache;
+	std::size_t mFrozenViews;
+	std::size_t mCachedViews;
 	std::unordered_map<ViewID, std::function<View::Ptr()>> mFactories;
 };
 
@@ -21,13 +21,31 @@ Window::~Window()
 }
 
 void
-Window::open(const std::string &title, unsigned width, unsigned height)
+Window::open(const std::string &title, unsigned width, unsigned height, bool visible)
 {
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+#ifdef GLFW_PLATFORM_NULL
+	// the null platform can create only OSMesa contexts
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API,
+		       glfwGetPlatform() == GLFW_PLATFORM_NULL
+		       ? GLFW_OSMESA_CONTEXT_API
+		       : GLFW_NATIVE_CONTEXT_API);
+#endif
 	glfwWindowHint(GLFW_DOUBLEBUFFER, GLFW_TRUE);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-	mWindow = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+
+	// 4.3 brings the compute shaders, 3.3 is enough for the rest
+	const int versions[][2] = { { 4, 3 }, { 3, 3 } };
+	for (const auto &version : versions)
+	{
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+		mWindow = glfwCreateWindow(width, height, title.c_str(), nullptr, nullptr);
+		if (mWindow)
+		{
+			break;
+		}
+	}
 	if (!mWindow)
 	{
 		const char *error;
@@ -103,6 +121,15 @@ Window::setContext(Window *window)
 	glfwMakeContextCurrent(window->mWindow);
 	glewExperimental = GL_TRUE;
 	GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// NOTE: a GLX build of GLEW loads the core entry points and
+	// then fails on the GLX ones when the context has no X display,
+	// as with the GLFW null platform or OSMesa.
+	if (err == GLEW_ERROR_NO_GLX_DISPLAY)
+	{
+		err = GLEW_OK;
+	}
+#endif
 	if (err != GLEW_OK)
 	{
 		glfwTerminate();
@@ -17,7 +17,13 @@ public:
 	Window& operator=(const Window &) = delete;
 	Window& operator=(Window &&) = delete;
 
-	void open(const std::string &title, unsigned width, unsigned height);
+	/**
+	 * Open the window and make its context current. A window not
+	 * @visible still has a context but its framebuffer can't be
+	 * drawn to, render into a RenderTexture instead.
+	 */
+	void open(const std::string &title, unsigned width, unsigned height,
+		  bool visible = true);
 	void close();
 	bool isClosed() const;
 	void display();